@@ -0,0 +1,456 @@
+#ifndef _AGGREGATE_INTERVAL_MAP_HPP
+#define _AGGREGATE_INTERVAL_MAP_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <random>
+#include <type_traits>
+#include <utility>
+
+/**
+ * Class implementing an interval map of numbers supporting range updates and range aggregates.
+ *
+ * The pairs are stored in a treap (a binary search tree balanced by random priorities), where
+ * each node keeps the aggregates of its subtree, and additions to a whole subtree are applied
+ * lazily. Adding a delta to an interval, assigning an interval, and computing the maximum or the
+ * sum over an interval all take O(log n) expected time. As in interval_map, consecutive pairs
+ * never have the same value.
+ *
+ * `T()` must be the additive identity. The sum is only available for arithmetic keys: it is the
+ * sum of the values of all the keys in the interval, weighting each pair by its length.
+ *
+ * @tparam Key The type of the key
+ * @tparam T The type of the values
+ * @tparam Compare Callable defining a strict weak ordering for the keys
+ */
+template<class Key, class T, class Compare = std::less<Key>>
+class aggregate_interval_map
+{
+public:
+    using key_type = Key;
+    using mapped_type = T;
+    using key_compare = Compare;
+    using size_type = std::size_t;
+
+protected:
+    /**
+     * Aggregates of a sequence of consecutive pairs.
+     */
+    struct summary
+    {
+        /**
+         * First and last key of the sequence, null if the sequence is empty.
+         */
+        const Key* first_key{ nullptr };
+        const Key* last_key{ nullptr };
+
+        /**
+         * Value of the last pair.
+         */
+        T last_val{};
+
+        /**
+         * Greatest value.
+         */
+        T max_val{};
+
+        /**
+         * Sum of the values weighted by the distance to the next key, for all but the last pair.
+         */
+        T sum{};
+    };
+
+    struct node
+    {
+        Key key;
+        T val;
+        std::uint32_t priority;
+        std::unique_ptr<node> left{};
+        std::unique_ptr<node> right{};
+
+        /**
+         * Aggregates of the subtree, including the pending addition.
+         */
+        summary agg{};
+
+        /**
+         * Addition applied to this node but not yet to its children.
+         */
+        T lazy{};
+
+        node(const Key& k, const T& v, std::uint32_t p) : key(k), val(v), priority(p) {}
+    };
+
+    using node_ptr = std::unique_ptr<node>;
+
+    /**
+     * First value.
+     *
+     * Keys map to this value if they come before all the pairs.
+     */
+    T first_val_;
+
+    /**
+     * Root of the treap.
+     */
+    node_ptr root_{};
+
+    /**
+     * Number of pairs.
+     */
+    size_type size_{ 0 };
+
+    /**
+     * Key comparator.
+     */
+    Compare comp_;
+
+    /**
+     * Generator of the priorities.
+     */
+    std::minstd_rand rng_{};
+
+public:
+    /**
+     * Constructor.
+     *
+     * @param first_val default value to which keys map if no match is found in the map.
+     * @param comp comparator used to order the keys
+     */
+    explicit aggregate_interval_map(const T& first_val, const Compare& comp = Compare()) :
+        first_val_(first_val),
+        comp_(comp)
+    {}
+
+    aggregate_interval_map(aggregate_interval_map&&) = default;
+    aggregate_interval_map& operator=(aggregate_interval_map&&) = default;
+
+    size_type size() const noexcept { return size_; }
+
+    const mapped_type& get_first_val() const noexcept { return first_val_; }
+
+    /**
+     * Returns the value that is mapped to a key equivalent to `key`.
+     *
+     * @param key the key of the element to find
+     * @return the mapped value
+     */
+    mapped_type at(const key_type& key) const
+    {
+        T pending{};
+        const node* found = nullptr;
+        T found_val{};
+
+        // Greatest key not greater than key, adding the pending additions along the path
+        for (const node* n = root_.get(); n != nullptr;) {
+            if (comp_(key, n->key)) {
+                pending += n->lazy;
+                n = n->left.get();
+            }
+            else {
+                found = n;
+                found_val = n->val + pending;
+                pending += n->lazy;
+                n = n->right.get();
+            }
+        }
+
+        return (found == nullptr ? first_val_ : found_val);
+    }
+
+    /**
+     * Calls `f(key, val)` on every pair of the map, in key order.
+     *
+     * @param f callable taking a const reference to a key and to a value
+     */
+    template<class F>
+    void for_each(F&& f) const { for_each(root_.get(), T{}, f); }
+
+    /**
+     * Assigns `val` to the interval [`key_begin`, `key_end`).
+     *
+     * @param key_begin the first key (included) of the interval
+     * @param key_end the last key (excluded) of the interval
+     * @param val the value to be assigned
+     */
+    void insert_range(const key_type& key_begin, const key_type& key_end, const mapped_type& val)
+    {
+        if (!comp_(key_begin, key_end))  return;
+
+        // Nodes are allocated before the treap is split, so that it is left untouched on failure
+        node_ptr begin_node = make_node(key_begin, val);
+        node_ptr end_node = make_node(key_end, at(key_end));
+        node_ptr left, middle, right;
+        split(std::move(root_), key_begin, left, middle);
+        split(std::move(middle), key_end, middle, right);
+
+        size_ -= count(middle.get());
+        middle = std::move(begin_node);
+        size_++;
+
+        join(std::move(left), std::move(middle), std::move(right), std::move(end_node));
+    }
+
+    /**
+     * Adds `delta` to the values of all the keys in [`key_begin`, `key_end`).
+     *
+     * @param key_begin the first key (included) of the interval
+     * @param key_end the last key (excluded) of the interval
+     * @param delta the value to be added
+     */
+    void add_range(const key_type& key_begin, const key_type& key_end, const mapped_type& delta)
+    {
+        if (!comp_(key_begin, key_end) || delta == T{})  return;
+
+        node_ptr begin_node = make_node(key_begin, at(key_begin));
+        node_ptr end_node = make_node(key_end, at(key_end));
+        node_ptr left, middle, right;
+        split(std::move(root_), key_begin, left, middle);
+        split(std::move(middle), key_end, middle, right);
+
+        if (middle == nullptr || comp_(key_begin, *middle->agg.first_key)) {
+            middle = merge(std::move(begin_node), std::move(middle));
+            size_++;
+        }
+        // Values inside the interval keep their differences, so only its ends can coalesce
+        apply(middle.get(), delta);
+
+        join(std::move(left), std::move(middle), std::move(right), std::move(end_node));
+    }
+
+    /**
+     * Returns the greatest value of the keys in [`key_begin`, `key_end`).
+     *
+     * @param key_begin the first key (included) of the interval
+     * @param key_end the last key (excluded) of the interval, which must be greater than `key_begin`
+     * @return the greatest value
+     */
+    mapped_type range_max(const key_type& key_begin, const key_type& key_end) const
+    {
+        const T begin_val = at(key_begin);
+        const summary inner = query(root_.get(), &key_begin, &key_end, T{});
+        return (inner.first_key == nullptr ? begin_val : std::max(begin_val, inner.max_val));
+    }
+
+    /**
+     * Returns the sum of the values of the keys in [`key_begin`, `key_end`), weighting each
+     * pair by the length of its intersection with the interval.
+     *
+     * @param key_begin the first key (included) of the interval
+     * @param key_end the last key (excluded) of the interval
+     * @return the sum
+     */
+    mapped_type range_sum(const key_type& key_begin, const key_type& key_end) const
+    {
+        static_assert(std::is_arithmetic_v<Key>, "aggregate_interval_map::range_sum requires arithmetic keys");
+
+        if (!comp_(key_begin, key_end))  return T{};
+
+        const T begin_val = at(key_begin);
+        const summary inner = query(root_.get(), &key_begin, &key_end, T{});
+
+        if (inner.first_key == nullptr)  return begin_val * T(key_end - key_begin);
+        return begin_val * T(*inner.first_key - key_begin) + inner.sum +
+            inner.last_val * T(key_end - *inner.last_key);
+    }
+
+private:
+    node_ptr make_node(const Key& key, const T& val)
+    {
+        node_ptr n(new node(key, val, static_cast<std::uint32_t>(rng_())));
+        n->agg = summarize(summary{}, *n, summary{});
+        return n;
+    }
+
+    static size_type count(const node* n)
+    {
+        return (n == nullptr ? 0 : 1 + count(n->left.get()) + count(n->right.get()));
+    }
+
+    /**
+     * Adds `delta` to the aggregates of a sequence.
+     */
+    static summary shift(summary s, const T& delta)
+    {
+        if (s.first_key == nullptr)  return s;
+
+        s.last_val += delta;
+        s.max_val += delta;
+        if constexpr (std::is_arithmetic_v<Key>) {
+            s.sum += delta * T(*s.last_key - *s.first_key);
+        }
+        return s;
+    }
+
+    /**
+     * Aggregates the sequence `left`, followed by the pair (`n.key`, `val`), followed by `right`.
+     */
+    static summary summarize(const summary& left, const node& n, const summary& right, const T& pending = T{})
+    {
+        const T val = n.val + pending;
+        summary s;
+        s.first_key = (left.first_key != nullptr ? left.first_key : &n.key);
+        s.last_key = (right.first_key != nullptr ? right.last_key : &n.key);
+        s.last_val = (right.first_key != nullptr ? right.last_val : val);
+        s.max_val = val;
+        if (left.first_key != nullptr)  s.max_val = std::max(s.max_val, left.max_val);
+        if (right.first_key != nullptr)  s.max_val = std::max(s.max_val, right.max_val);
+
+        if constexpr (std::is_arithmetic_v<Key>) {
+            if (left.first_key != nullptr)  s.sum += left.sum + left.last_val * T(n.key - *left.last_key);
+            if (right.first_key != nullptr)  s.sum += val * T(*right.first_key - n.key) + right.sum;
+        }
+        return s;
+    }
+
+    static summary summary_of(const node* n) { return (n == nullptr ? summary{} : n->agg); }
+
+    static void apply(node* n, const T& delta)
+    {
+        if (n == nullptr)  return;
+        n->val += delta;
+        n->lazy += delta;
+        n->agg = shift(n->agg, delta);
+    }
+
+    static void push(node* n)
+    {
+        if (n->lazy == T{})  return;
+        apply(n->left.get(), n->lazy);
+        apply(n->right.get(), n->lazy);
+        n->lazy = T{};
+    }
+
+    static void pull(node* n)
+    {
+        n->agg = summarize(summary_of(n->left.get()), *n, summary_of(n->right.get()));
+    }
+
+    /**
+     * Splits `t` into the keys less than `key`, and the others.
+     */
+    void split(node_ptr t, const Key& key, node_ptr& left, node_ptr& right) const
+    {
+        if (t == nullptr) {
+            left.reset();
+            right.reset();
+            return;
+        }
+
+        push(t.get());
+        if (comp_(t->key, key)) {
+            split(std::move(t->right), key, t->right, right);
+            pull(t.get());
+            left = std::move(t);
+        }
+        else {
+            split(std::move(t->left), key, left, t->left);
+            pull(t.get());
+            right = std::move(t);
+        }
+    }
+
+    /**
+     * Joins two treaps, where all the keys of `left` are less than the keys of `right`.
+     */
+    static node_ptr merge(node_ptr left, node_ptr right)
+    {
+        if (left == nullptr)  return right;
+        if (right == nullptr)  return left;
+
+        if (left->priority > right->priority) {
+            push(left.get());
+            left->right = merge(std::move(left->right), std::move(right));
+            pull(left.get());
+            return left;
+        }
+        else {
+            push(right.get());
+            right->left = merge(std::move(left), std::move(right->left));
+            pull(right.get());
+            return right;
+        }
+    }
+
+    /**
+     * Returns the value of the first pair of the non-empty treap `t`.
+     */
+    static T leftmost_val(const node* t)
+    {
+        T pending{};
+        for (; t->left != nullptr; t = t->left.get())  pending += t->lazy;
+        return t->val + pending;
+    }
+
+    void erase_first(node_ptr& t)
+    {
+        push(t.get());
+        if (t->left != nullptr) {
+            erase_first(t->left);
+            pull(t.get());
+        }
+        else {
+            t = std::move(t->right);
+            size_--;
+        }
+    }
+
+    /**
+     * Puts back the treaps split around a modified interval, restoring the value that followed
+     * the interval, and erasing the pairs at the ends of the interval that repeat the previous value.
+     *
+     * @param left the pairs before the interval
+     * @param middle the pairs of the interval, starting with a pair at its first key
+     * @param right the pairs after the interval
+     * @param end_node pair at the last key (excluded) of the interval, with the value it mapped to
+     */
+    void join(node_ptr left, node_ptr middle, node_ptr right, node_ptr end_node)
+    {
+        const T end_val = end_node->val;
+        if (right == nullptr || comp_(end_node->key, *right->agg.first_key)) {
+            right = merge(std::move(end_node), std::move(right));
+            size_++;
+        }
+
+        const T prev_val = (left != nullptr ? left->agg.last_val : first_val_);
+        if (leftmost_val(middle.get()) == prev_val)  erase_first(middle);
+
+        const T last_val = (middle != nullptr ? middle->agg.last_val : prev_val);
+        if (end_val == last_val)  erase_first(right);
+
+        root_ = merge(merge(std::move(left), std::move(middle)), std::move(right));
+    }
+
+    /**
+     * Aggregates the pairs of `n` whose keys are greater than `*lo` and less than `*hi`, a null
+     * bound meaning unbounded.
+     *
+     * @param pending addition not yet applied to `n`
+     */
+    summary query(const node* n, const Key* lo, const Key* hi, const T& pending) const
+    {
+        if (n == nullptr)  return summary{};
+
+        if (lo != nullptr && !comp_(*lo, n->key))  return query(n->right.get(), lo, hi, pending + n->lazy);
+        if (hi != nullptr && !comp_(n->key, *hi))  return query(n->left.get(), lo, hi, pending + n->lazy);
+
+        const T child_pending = pending + n->lazy;
+        const summary left = (lo != nullptr ? query(n->left.get(), lo, nullptr, child_pending) : shift(summary_of(n->left.get()), child_pending));
+        const summary right = (hi != nullptr ? query(n->right.get(), nullptr, hi, child_pending) : shift(summary_of(n->right.get()), child_pending));
+        return summarize(left, *n, right, pending);
+    }
+
+    template<class F>
+    static void for_each(const node* n, const T& pending, F& f)
+    {
+        if (n == nullptr)  return;
+        for_each(n->left.get(), pending + n->lazy, f);
+        f(n->key, n->val + pending);
+        for_each(n->right.get(), pending + n->lazy, f);
+    }
+};
+
+#endif
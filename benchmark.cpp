@@ -0,0 +1,492 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "flat_map.hpp"
+#include "interval_map.hpp"
+#include "pool_allocator.hpp"
+
+/**
+ * Number of allocations made through counting_allocator.
+ */
+static std::size_t n_allocations = 0;
+
+/**
+ * Sink for the results of the lookups, so that they are not optimized away.
+ */
+static volatile std::int64_t lookup_sink = 0;
+
+/**
+ * Allocator counting the allocations.
+ */
+template<class T>
+struct counting_allocator : std::allocator<T>
+{
+    template<class U>
+    struct rebind { using other = counting_allocator<U>; };
+
+    counting_allocator() = default;
+
+    template<class U>
+    counting_allocator(const counting_allocator<U>&) noexcept {}
+
+    T* allocate(std::size_t n)
+    {
+        n_allocations++;
+        return std::allocator<T>::allocate(n);
+    }
+};
+
+/**
+ * Interval map backed by a std::map, counting its allocations.
+ */
+template<class Key>
+struct map_backend
+{
+    static constexpr const char* name = "map";
+    static constexpr bool contiguous = false;
+
+    using allocator_type = counting_allocator<std::pair<const Key, int>>;
+    using type = interval_map<Key, int, std::less<Key>, allocator_type>;
+
+    static std::size_t allocations(const type&) { return n_allocations; }
+};
+
+/**
+ * Interval map backed by a std::map with pooled nodes, counting the allocations of the pool.
+ */
+template<class Key>
+struct pooled_backend
+{
+    static constexpr const char* name = "pooled";
+    static constexpr bool contiguous = false;
+
+    using type = pooled_interval_map<Key, int>;
+
+    static std::size_t allocations(const type& imap) { return imap.get_allocator().pool()->upstream_allocations(); }
+};
+
+/**
+ * Interval map backed by a flat_map, counting its allocations.
+ */
+template<class Key>
+struct flat_backend
+{
+    static constexpr const char* name = "flat";
+    static constexpr bool contiguous = true;
+
+    using type = interval_map<
+        Key,
+        int,
+        std::less<Key>,
+        counting_allocator<std::pair<const Key, int>>,
+        flat_map<Key, int, std::less<Key>, std::vector<Key, counting_allocator<Key>>, std::vector<int, counting_allocator<int>>>
+    >;
+
+    static std::size_t allocations(const type&) { return n_allocations; }
+};
+
+template<class Key> Key make_key(std::uint64_t i);
+template<> int make_key<int>(std::uint64_t i) { return static_cast<int>(i); }
+template<> std::int64_t make_key<std::int64_t>(std::uint64_t i) { return static_cast<std::int64_t>(i); }
+
+/**
+ * String keys are zero-padded, so that they sort like the integers they are made from.
+ */
+template<> std::string make_key<std::string>(std::uint64_t i)
+{
+    char buf[24];
+    std::snprintf(buf, sizeof(buf), "%012llu", static_cast<unsigned long long>(i));
+    return buf;
+}
+
+template<class Key> const char* key_name();
+template<> const char* key_name<int>() { return "int"; }
+template<> const char* key_name<std::int64_t>() { return "int64"; }
+template<> const char* key_name<std::string>() { return "string"; }
+
+/**
+ * Generator of Zipf-distributed ranks in [0, n), from Gray et al., "Quickly generating
+ * billion-record synthetic databases".
+ */
+class zipf_distribution
+{
+    std::uint64_t n_;
+    double theta_;
+    double zeta_n_;
+    double alpha_;
+    double eta_;
+
+public:
+    zipf_distribution(std::uint64_t n, double theta) :
+        n_(n),
+        theta_(theta)
+    {
+        double zeta = 0;
+        for (std::uint64_t i = 1; i <= n; i++)  zeta += 1 / std::pow(static_cast<double>(i), theta);
+        zeta_n_ = zeta;
+        alpha_ = 1 / (1 - theta);
+        eta_ = (1 - std::pow(2.0 / static_cast<double>(n), 1 - theta)) / (1 - (1 + std::pow(0.5, theta)) / zeta_n_);
+    }
+
+    template<class Generator>
+    std::uint64_t operator()(Generator& gen)
+    {
+        const double u = std::uniform_real_distribution<double>(0, 1)(gen);
+        const double uz = u * zeta_n_;
+        if (uz < 1)  return 0;
+        if (uz < 1 + std::pow(0.5, theta_))  return 1;
+        return std::min<std::uint64_t>(n_ - 1, static_cast<std::uint64_t>(static_cast<double>(n_) * std::pow(eta_ * u - eta_ + 1, alpha_)));
+    }
+};
+
+/**
+ * Workload families.
+ */
+enum class workload
+{
+    uniform,      // insert_range at uniformly random positions
+    zipf,         // insert_range at Zipf-distributed positions, so a few segments are hot
+    sequential,   // insert_range appending after the last segment
+    batch,        // uniform intervals applied with insert_ranges, in batches of batch_size
+    rebuild,      // uniform intervals applied with a single parallel insert_ranges
+    lookup,       // 95% at, 5% uniform insert_range
+    lookup_batch, // at uniformly random keys, looked up with at_many_unsorted in batches of batch_size
+    sweep,        // 90% at, 10% insert_range, at keys moving forward by small steps
+    sweep_cursor  // the same operations as sweep, through a cursor
+};
+
+static const char* workload_name(workload w)
+{
+    switch (w) {
+    case workload::uniform: return "uniform";
+    case workload::zipf: return "zipf";
+    case workload::sequential: return "sequential";
+    case workload::batch: return "batch";
+    case workload::rebuild: return "rebuild";
+    case workload::lookup: return "lookup";
+    case workload::lookup_batch: return "lookup_batch";
+    case workload::sweep: return "sweep";
+    case workload::sweep_cursor: return "sweep_cursor";
+    }
+    return "";
+}
+
+/**
+ * Distance between the keys of consecutive segments of the initial map.
+ */
+static constexpr std::uint64_t key_stride = 16;
+
+static constexpr std::size_t batch_size = 100;
+
+/**
+ * Operation of a workload, with its keys already built so that building them is not timed.
+ */
+template<class Key>
+struct operation
+{
+    bool lookup;
+    Key key_begin;
+    Key key_end;
+    int val;
+};
+
+template<class Key>
+std::vector<operation<Key>> make_operations(workload w, std::size_t size, std::size_t n_ops, std::mt19937_64& gen)
+{
+    const std::uint64_t key_space = size * key_stride;
+    std::uniform_int_distribution<std::uint64_t> uniform_key(0, key_space - 1);
+    std::uniform_int_distribution<std::uint64_t> length(1, 4 * key_stride);
+    std::uniform_int_distribution<int> val(1, 8);
+    std::uniform_int_distribution<int> percent(0, 99);
+    std::unique_ptr<zipf_distribution> zipf;
+    if (w == workload::zipf)  zipf.reset(new zipf_distribution(size, 0.99));
+
+    std::vector<operation<Key>> ops;
+    ops.reserve(n_ops);
+    std::uint64_t cursor = (w == workload::sequential ? key_space : 0);
+
+    for (std::size_t i = 0; i < n_ops; i++) {
+        std::uint64_t key_begin = 0;
+        bool lookup = false;
+
+        switch (w) {
+        case workload::zipf:
+            // Hot ranks are scattered over the keys
+            key_begin = ((*zipf)(gen) * 2654435761u % size) * key_stride + gen() % key_stride;
+            break;
+        case workload::sequential:
+            key_begin = cursor;
+            break;
+        case workload::lookup:
+            lookup = (percent(gen) < 95);
+            key_begin = uniform_key(gen);
+            break;
+        case workload::lookup_batch:
+            lookup = true;
+            key_begin = uniform_key(gen);
+            break;
+        case workload::sweep:
+        case workload::sweep_cursor:
+            lookup = (percent(gen) < 90);
+            cursor = (cursor + gen() % key_stride) % key_space;
+            key_begin = cursor;
+            break;
+        default:
+            key_begin = uniform_key(gen);
+            break;
+        }
+
+        const std::uint64_t key_end = key_begin + length(gen);
+        if (w == workload::sequential)  cursor = key_end;
+        ops.push_back({ lookup, make_key<Key>(key_begin), make_key<Key>(key_end), val(gen) });
+    }
+
+    return ops;
+}
+
+/**
+ * Measures of a benchmark run.
+ */
+struct result
+{
+    double ns_per_op;
+    double p50_ns;
+    double p99_ns;
+    double allocations_per_op;
+};
+
+/**
+ * Runs a workload on a map with `size` segments.
+ *
+ * Latencies are measured around each operation, except for the batch, rebuild and lookup_batch workloads,
+ * where each operation is assigned the average latency of its batch.
+ */
+template<class Backend, class Key>
+result run(workload w, std::size_t size, std::size_t n_ops, std::uint64_t seed, std::size_t n_threads)
+{
+    using map_type = typename Backend::type;
+
+    std::mt19937_64 gen(seed);
+    const std::vector<operation<Key>> ops = make_operations<Key>(w, size, n_ops, gen);
+
+    std::vector<std::pair<Key, int>> segments;
+    segments.reserve(size);
+    for (std::size_t i = 0; i < size; i++)  segments.emplace_back(make_key<Key>(i * key_stride), 1 + static_cast<int>(i % 7));
+    map_type imap(0, segments.begin(), segments.end());
+    segments.clear();
+    segments.shrink_to_fit();
+
+    std::vector<double> latencies;
+    latencies.reserve(n_ops);
+    const std::size_t allocations_before = Backend::allocations(imap);
+    std::int64_t sum = 0;
+    const auto start = std::chrono::steady_clock::now();
+
+    if (w == workload::batch || w == workload::rebuild) {
+        const std::size_t n_batch = (w == workload::batch ? batch_size : ops.size());
+        std::vector<std::tuple<Key, Key, int>> ranges;
+        for (std::size_t i = 0; i < ops.size(); i += n_batch) {
+            ranges.clear();
+            const std::size_t n = std::min(n_batch, ops.size() - i);
+            for (std::size_t j = i; j < i + n; j++)  ranges.emplace_back(ops[j].key_begin, ops[j].key_end, ops[j].val);
+
+            const auto op_start = std::chrono::steady_clock::now();
+            if (w == workload::batch)  imap.insert_ranges(ranges.begin(), ranges.end());
+            else  imap.insert_ranges(ranges.begin(), ranges.end(), n_threads);
+            const auto op_end = std::chrono::steady_clock::now();
+            const double ns = std::chrono::duration<double, std::nano>(op_end - op_start).count();
+            latencies.insert(latencies.end(), n, ns / static_cast<double>(n));
+        }
+    }
+    else if (w == workload::lookup_batch) {
+        std::vector<Key> keys;
+        std::vector<int> vals(batch_size);
+        for (std::size_t i = 0; i < ops.size(); i += batch_size) {
+            keys.clear();
+            const std::size_t n = std::min(batch_size, ops.size() - i);
+            for (std::size_t j = i; j < i + n; j++)  keys.push_back(ops[j].key_begin);
+
+            const auto op_start = std::chrono::steady_clock::now();
+            imap.at_many_unsorted(keys.begin(), keys.end(), vals.begin());
+            const auto op_end = std::chrono::steady_clock::now();
+            const double ns = std::chrono::duration<double, std::nano>(op_end - op_start).count();
+            latencies.insert(latencies.end(), n, ns / static_cast<double>(n));
+            for (std::size_t j = 0; j < n; j++)  sum += vals[j];
+        }
+    }
+    else if (w == workload::sweep_cursor) {
+        typename map_type::cursor cursor(imap);
+        for (const operation<Key>& op : ops) {
+            const auto op_start = std::chrono::steady_clock::now();
+            if (op.lookup)  sum += cursor.at(op.key_begin);
+            else  cursor.insert_range(op.key_begin, op.key_end, op.val);
+            const auto op_end = std::chrono::steady_clock::now();
+            latencies.push_back(std::chrono::duration<double, std::nano>(op_end - op_start).count());
+        }
+    }
+    else {
+        for (const operation<Key>& op : ops) {
+            const auto op_start = std::chrono::steady_clock::now();
+            if (op.lookup)  sum += imap.at(op.key_begin);
+            else  imap.insert_range(op.key_begin, op.key_end, op.val);
+            const auto op_end = std::chrono::steady_clock::now();
+            latencies.push_back(std::chrono::duration<double, std::nano>(op_end - op_start).count());
+        }
+    }
+
+    const auto end = std::chrono::steady_clock::now();
+    const std::size_t allocations = Backend::allocations(imap) - allocations_before;
+    lookup_sink = lookup_sink + sum;
+
+    auto percentile = [&latencies](double p) {
+        auto nth = latencies.begin() + static_cast<std::ptrdiff_t>(p * static_cast<double>(latencies.size() - 1));
+        std::nth_element(latencies.begin(), nth, latencies.end());
+        return *nth;
+    };
+
+    result r;
+    r.ns_per_op = std::chrono::duration<double, std::nano>(end - start).count() / static_cast<double>(n_ops);
+    r.p50_ns = percentile(0.5);
+    r.p99_ns = percentile(0.99);
+    r.allocations_per_op = static_cast<double>(allocations) / static_cast<double>(n_ops);
+    return r;
+}
+
+/**
+ * Options from the command line.
+ */
+struct options
+{
+    std::size_t min_size = 100;
+    std::size_t max_size = 100000;
+    std::size_t n_ops = 20000;
+    std::uint64_t seed = 0;
+    std::size_t n_threads = std::max(1u, std::thread::hardware_concurrency());
+    bool csv = false;
+
+    /**
+     * Largest map on which contiguous backends run write workloads, whose operations take
+     * linear time.
+     */
+    std::size_t max_contiguous_write_size = 100000;
+};
+
+template<class Backend, class Key>
+void run_all(const options& opts)
+{
+    const workload workloads[] = {
+        workload::uniform,
+        workload::zipf,
+        workload::sequential,
+        workload::batch,
+        workload::rebuild,
+        workload::lookup,
+        workload::lookup_batch,
+        workload::sweep,
+        workload::sweep_cursor
+    };
+
+    for (std::size_t size = opts.min_size; size <= opts.max_size; size *= 10) {
+        for (workload w : workloads) {
+            // A rebuild merges the map once, in linear time
+            const bool writes = (w != workload::lookup && w != workload::lookup_batch && w != workload::sweep && w != workload::sweep_cursor && w != workload::rebuild);
+            if (Backend::contiguous && writes && size > opts.max_contiguous_write_size)  continue;
+
+            const result r = run<Backend, Key>(w, size, opts.n_ops, opts.seed, opts.n_threads);
+
+            if (opts.csv) {
+                std::cout << Backend::name << ',' << key_name<Key>() << ',' << workload_name(w) << ','
+                    << size << ',' << opts.n_ops << ',' << r.ns_per_op << ',' << r.p50_ns << ','
+                    << r.p99_ns << ',' << r.allocations_per_op << '\n';
+            }
+            else {
+                std::cout << std::left << std::setw(8) << Backend::name << std::setw(8) << key_name<Key>()
+                    << std::setw(14) << workload_name(w) << std::right << std::setw(10) << size
+                    << std::fixed << std::setprecision(1) << std::setw(12) << r.ns_per_op
+                    << std::setw(12) << r.p50_ns << std::setw(12) << r.p99_ns
+                    << std::setprecision(3) << std::setw(12) << r.allocations_per_op << '\n';
+            }
+        }
+    }
+}
+
+template<class Key>
+void run_backends(const options& opts)
+{
+    run_all<map_backend<Key>, Key>(opts);
+    run_all<pooled_backend<Key>, Key>(opts);
+    run_all<flat_backend<Key>, Key>(opts);
+}
+
+static void usage(const char* program)
+{
+    std::cerr << "Usage: " << program << " [--csv] [--min-size N] [--max-size N] [--ops N] [--seed N] [--threads N]\n"
+        << "  --csv         print comma-separated values\n"
+        << "  --min-size N  smallest number of segments in the map (default 100)\n"
+        << "  --max-size N  largest number of segments in the map, up to 10000000 (default 100000)\n"
+        << "  --ops N       number of operations per run (default 20000)\n"
+        << "  --seed N      seed of the random generator (default 0)\n"
+        << "  --threads N   threads of the rebuild workload (default: the number of cores)\n";
+}
+
+int main(int argc, char** argv)
+{
+    options opts;
+
+    for (int i = 1; i < argc; i++) {
+        auto value = [&]() -> std::uint64_t {
+            if (i + 1 >= argc) {
+                usage(argv[0]);
+                std::exit(1);
+            }
+            return std::strtoull(argv[++i], nullptr, 10);
+        };
+
+        if (std::strcmp(argv[i], "--csv") == 0)  opts.csv = true;
+        else if (std::strcmp(argv[i], "--min-size") == 0)  opts.min_size = value();
+        else if (std::strcmp(argv[i], "--max-size") == 0)  opts.max_size = value();
+        else if (std::strcmp(argv[i], "--ops") == 0)  opts.n_ops = value();
+        else if (std::strcmp(argv[i], "--seed") == 0)  opts.seed = value();
+        else if (std::strcmp(argv[i], "--threads") == 0)  opts.n_threads = value();
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (opts.min_size == 0 || opts.n_ops == 0 || opts.n_threads == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (opts.csv) {
+        std::cout << "backend,key,workload,size,ops,ns_per_op,p50_ns,p99_ns,allocations_per_op\n";
+    }
+    else {
+        std::cout << std::left << std::setw(8) << "backend" << std::setw(8) << "key" << std::setw(14) << "workload"
+            << std::right << std::setw(10) << "size" << std::setw(12) << "ns/op" << std::setw(12) << "p50 ns"
+            << std::setw(12) << "p99 ns" << std::setw(12) << "allocs/op" << '\n';
+    }
+
+    run_backends<int>(opts);
+    run_backends<std::int64_t>(opts);
+    run_backends<std::string>(opts);
+
+    return 0;
+}
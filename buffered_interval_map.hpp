@@ -0,0 +1,180 @@
+#ifndef _BUFFERED_INTERVAL_MAP_HPP
+#define _BUFFERED_INTERVAL_MAP_HPP
+
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "interval_map.hpp"
+
+/**
+ * Class implementing an interval map whose assignments are buffered, and applied in bulk.
+ *
+ * `insert_range` writes to a small buffer: a flat interval map mapping each key either to the
+ * value last assigned to it since the last flush, or to nothing. Assignments overwriting each
+ * other in the buffer are coalesced there, at the cost of moving a few contiguous elements, and
+ * never reach the main container. When the buffer holds `threshold` pairs, or on `flush`, its
+ * intervals are merged into the main map with a single `insert_ranges`.
+ *
+ * Lookups check the buffer first, so they always see the last assignments. The other mutations,
+ * and accessing the main map, flush the buffer first.
+ *
+ * @tparam Key The type of the key
+ * @tparam T The type of the values
+ * @tparam Compare Callable defining a strict weak ordering for the keys
+ * @tparam Allocator Allocator of each element in the container
+ * @tparam Container Container used inside the class
+ */
+template<
+    class Key,
+    class T,
+    class Compare = std::less<Key>,
+    class Allocator = std::allocator<std::pair<const Key, T>>,
+    class Container = std::map<Key, T, Compare, Allocator>
+>
+class buffered_interval_map
+{
+public:
+    using map_type = interval_map<Key, T, Compare, Allocator, Container>;
+    using buffer_type = flat_interval_map<Key, std::optional<T>, Compare>;
+    using key_type = Key;
+    using mapped_type = T;
+    using size_type = typename map_type::size_type;
+
+    static constexpr size_type default_threshold = 256;
+
+protected:
+    /**
+     * Main map, without the buffered assignments.
+     */
+    map_type map_;
+
+    /**
+     * Buffered assignments, where keys not assigned since the last flush map to nothing.
+     */
+    buffer_type buffer_{ std::optional<T>() };
+
+    /**
+     * Number of pairs in the buffer from which it is flushed.
+     */
+    size_type threshold_;
+
+public:
+    /**
+     * Constructor.
+     *
+     * @param first_val default value to which keys map if no match is found in the map.
+     * @param threshold number of pairs in the buffer from which it is flushed
+     */
+    explicit buffered_interval_map(const T& first_val, size_type threshold = default_threshold) :
+        map_(first_val),
+        threshold_(threshold)
+    {}
+
+    /**
+     * Constructor.
+     *
+     * @param imap map to be moved, which must have a first value
+     * @param threshold number of pairs in the buffer from which it is flushed
+     */
+    explicit buffered_interval_map(map_type&& imap, size_type threshold = default_threshold) :
+        map_(std::move(imap)),
+        threshold_(threshold)
+    {
+        map_.get_first_val();
+    }
+
+    /**
+     * Returns the main map, after flushing the buffer.
+     *
+     * @return a const reference to the map
+     */
+    const map_type& map()
+    {
+        flush();
+        return map_;
+    }
+
+    /**
+     * Returns the number of pairs in the buffer.
+     */
+    size_type buffered() const { return buffer_.size(); }
+
+    const mapped_type& get_first_val() const { return map_.get_first_val(); }
+
+    /**
+     * Sets the first value, after flushing the buffer.
+     *
+     * @param val value to be assigned
+     */
+    void set_first_val(const mapped_type& val)
+    {
+        flush();
+        map_.set_first_val(val);
+    }
+
+    /**
+     * Manually inserts a pair to the map, after flushing the buffer.
+     *
+     * @param key the key to which the value maps
+     * @param val the value to be assigned
+     */
+    void insert(const key_type& key, const mapped_type& val)
+    {
+        flush();
+        map_.insert(key, val);
+    }
+
+    /**
+     * Assigns `val` to the interval [`key_begin`, `key_end`) in the buffer, flushing it if it
+     * reaches the threshold.
+     *
+     * @param key_begin the first key (included) of the interval
+     * @param key_end the last key (excluded) of the interval
+     * @param val the value to be assigned
+     */
+    void insert_range(const key_type& key_begin, const key_type& key_end, const mapped_type& val)
+    {
+        buffer_.insert_range(key_begin, key_end, std::optional<T>(val));
+        if (buffer_.size() >= threshold_)  flush();
+    }
+
+    /**
+     * Returns a const reference to the value that is mapped to a key equivalent to `key`,
+     * looking it up in the buffer first.
+     *
+     * @param key the key of the element to find
+     * @return a const reference to the mapped value, valid until the next mutation
+     */
+    const mapped_type& at(const key_type& key) const
+    {
+        const std::optional<T>& val = buffer_.at(key);
+        return (val ? *val : map_.at(key));
+    }
+
+    /**
+     * Merges the buffered assignments into the main map.
+     */
+    void flush()
+    {
+        if (buffer_.size() == 0)  return;
+
+        std::vector<std::tuple<Key, Key, T>> ranges;
+        ranges.reserve(buffer_.size() / 2 + 1);
+
+        // The buffer ends with a pair mapping to nothing, as every interval has an end
+        for (auto it = buffer_.begin(); std::next(it) != buffer_.end(); it++) {
+            if (it->second)  ranges.emplace_back(it->first, std::next(it)->first, *it->second);
+        }
+
+        map_.insert_ranges(ranges.begin(), ranges.end());
+        buffer_ = buffer_type(std::optional<T>());
+    }
+};
+
+#endif
@@ -0,0 +1,303 @@
+#ifndef _CONCURRENT_INTERVAL_MAP_HPP
+#define _CONCURRENT_INTERVAL_MAP_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "interval_map.hpp"
+
+/**
+ * Class implementing an interval map shared by a single writer and many concurrent readers.
+ *
+ * Readers look up immutable versions of the map, and never wait for the writer or for each
+ * other: a lookup takes a constant number of atomic operations on top of the search itself. The
+ * writer modifies a private copy of the map and publishes it as a new version by swapping a
+ * pointer, so readers always see a consistent version. Old versions are reclaimed by epochs:
+ * each reader announces the epoch at which it started reading, and a version is deleted once
+ * no reader that started before it was replaced is still reading.
+ *
+ * Publishing a version copies the map, so several modifications should be grouped with
+ * `update`. Calls to the modifiers must not run concurrently with each other.
+ *
+ * @tparam Key The type of the key
+ * @tparam T The type of the values
+ * @tparam Compare Callable defining a strict weak ordering for the keys
+ * @tparam Allocator Allocator of each element in the container
+ * @tparam Container Container used inside the class
+ */
+template<
+    class Key,
+    class T,
+    class Compare = std::less<Key>,
+    class Allocator = std::allocator<std::pair<const Key, T>>,
+    class Container = std::map<Key, T, Compare, Allocator>
+>
+class concurrent_interval_map
+{
+public:
+    using map_type = interval_map<Key, T, Compare, Allocator, Container>;
+    using key_type = typename map_type::key_type;
+    using mapped_type = typename map_type::mapped_type;
+    using size_type = typename map_type::size_type;
+
+protected:
+    /**
+     * Epoch announced by a reader, padded to a cache line to avoid false sharing.
+     */
+    struct alignas(64) reader_slot
+    {
+        /**
+         * Epoch at which the current read started, 0 if the reader is not reading.
+         */
+        std::atomic<std::uint64_t> epoch{ 0 };
+
+        /**
+         * True if the slot belongs to a reader.
+         */
+        std::atomic<bool> used{ false };
+    };
+
+    /**
+     * Version replaced by the writer, waiting for the readers that may still use it.
+     */
+    struct retired_version
+    {
+        const map_type* map;
+        std::uint64_t epoch;
+    };
+
+    /**
+     * Writer's copy of the map.
+     */
+    map_type writer_map_;
+
+    /**
+     * Version visible to the readers.
+     */
+    std::atomic<const map_type*> current_;
+
+    /**
+     * Global epoch, incremented each time a version is published.
+     */
+    std::atomic<std::uint64_t> epoch_{ 1 };
+
+    /**
+     * Slots of the readers.
+     */
+    std::unique_ptr<reader_slot[]> slots_;
+
+    /**
+     * Number of reader slots.
+     */
+    std::size_t n_slots_;
+
+    /**
+     * Versions that have been replaced but not deleted yet.
+     */
+    std::vector<retired_version> retired_{};
+
+public:
+    /**
+     * Handle through which a thread reads the map.
+     *
+     * A reader owns one of the map's reader slots, and must not outlive the map. Each reader
+     * must be used by one thread at a time.
+     */
+    class reader
+    {
+        friend class concurrent_interval_map;
+
+        const concurrent_interval_map* map_;
+        reader_slot* slot_;
+
+        reader(const concurrent_interval_map* map, reader_slot* slot) : map_(map), slot_(slot) {}
+
+    public:
+        reader(reader&& other) noexcept :
+            map_(other.map_),
+            slot_(std::exchange(other.slot_, nullptr))
+        {}
+
+        reader& operator=(reader&& other) noexcept
+        {
+            if (this != &other) {
+                release();
+                map_ = other.map_;
+                slot_ = std::exchange(other.slot_, nullptr);
+            }
+            return *this;
+        }
+
+        reader(const reader&) = delete;
+        reader& operator=(const reader&) = delete;
+
+        ~reader() { release(); }
+
+        /**
+         * Calls `f` on the current version of the map.
+         *
+         * The version stays alive until `f` returns, so `f` must not return references into it.
+         *
+         * @param f callable taking a const reference to the map
+         * @return the value returned by `f`
+         */
+        template<class F>
+        auto read(F&& f) const
+        {
+            struct guard
+            {
+                reader_slot* slot;
+                std::uint64_t prev_epoch;
+
+                ~guard() { slot->epoch.store(prev_epoch, std::memory_order_release); }
+            } g{ slot_, slot_->epoch.load(std::memory_order_relaxed) };
+
+            // Nested reads keep the epoch of the outermost one
+            if (g.prev_epoch == 0)  slot_->epoch.store(map_->epoch_.load());
+
+            return f(*map_->current_.load());
+        }
+
+        /**
+         * Returns a copy of the value that is mapped to a key equivalent to `key`.
+         *
+         * @param key the key of the element to find
+         * @return the mapped value in the current version of the map
+         */
+        mapped_type at(const key_type& key) const
+        {
+            return read([&key](const map_type& imap) { return imap.at(key); });
+        }
+
+    private:
+        void release() noexcept
+        {
+            if (slot_ != nullptr)  slot_->used.store(false);
+            slot_ = nullptr;
+        }
+    };
+
+    /**
+     * Constructor.
+     *
+     * @param first_val default value to which keys map if no match is found in the map.
+     * @param max_readers maximum number of readers existing at the same time
+     */
+    explicit concurrent_interval_map(const mapped_type& first_val, std::size_t max_readers = 128) :
+        concurrent_interval_map(map_type(first_val), max_readers)
+    {}
+
+    /**
+     * Constructor.
+     *
+     * @param imap initial content of the map
+     * @param max_readers maximum number of readers existing at the same time
+     */
+    explicit concurrent_interval_map(map_type imap, std::size_t max_readers = 128) :
+        writer_map_(std::move(imap)),
+        current_(new map_type(writer_map_)),
+        slots_(new reader_slot[max_readers]),
+        n_slots_(max_readers)
+    {}
+
+    concurrent_interval_map(const concurrent_interval_map&) = delete;
+    concurrent_interval_map& operator=(const concurrent_interval_map&) = delete;
+
+    /**
+     * Destructor.
+     *
+     * All the readers must have been destroyed.
+     */
+    ~concurrent_interval_map()
+    {
+        delete current_.load();
+        for (const retired_version& version : retired_)  delete version.map;
+    }
+
+    /**
+     * Creates a reader.
+     *
+     * @return the reader
+     */
+    reader make_reader() const
+    {
+        for (std::size_t i = 0; i < n_slots_; i++) {
+            bool used = false;
+            if (slots_[i].used.compare_exchange_strong(used, true))  return reader(this, &slots_[i]);
+        }
+        throw std::runtime_error("concurrent_interval_map::make_reader");
+    }
+
+    /**
+     * Returns the writer's copy of the map, which reflects all the published modifications.
+     *
+     * Only the writer thread may call this function.
+     *
+     * @return a const reference to the writer's map
+     */
+    const map_type& writer_view() const noexcept { return writer_map_; }
+
+    /**
+     * Applies `f` to the map, and publishes the result as a single new version.
+     *
+     * @param f callable taking a reference to the map
+     */
+    template<class F>
+    void update(F&& f)
+    {
+        f(writer_map_);
+        publish();
+    }
+
+    void set_first_val(const mapped_type& val)
+    {
+        update([&](map_type& imap) { imap.set_first_val(val); });
+    }
+
+    void insert(const key_type& key, const mapped_type& val)
+    {
+        update([&](map_type& imap) { imap.insert(key, val); });
+    }
+
+    void insert_range(const key_type& key_begin, const key_type& key_end, const mapped_type& val)
+    {
+        update([&](map_type& imap) { imap.insert_range(key_begin, key_end, val); });
+    }
+
+    template<class ForwardIt>
+    void insert_ranges(ForwardIt first, ForwardIt last)
+    {
+        update([&](map_type& imap) { imap.insert_ranges(first, last); });
+    }
+
+private:
+    /**
+     * Makes a copy of the writer's map visible to the readers, and deletes the versions that
+     * no reader can be using anymore.
+     */
+    void publish()
+    {
+        const map_type* next = new map_type(writer_map_);
+        const map_type* prev = current_.exchange(next);
+
+        // Readers announcing an epoch greater than this one loaded the new version
+        retired_.push_back({ prev, epoch_.fetch_add(1) });
+
+        std::uint64_t min_epoch = UINT64_MAX;
+        for (std::size_t i = 0; i < n_slots_; i++) {
+            const std::uint64_t epoch = slots_[i].epoch.load();
+            if (epoch != 0 && epoch < min_epoch)  min_epoch = epoch;
+        }
+
+        auto it = retired_.begin();
+        for (; it != retired_.end() && it->epoch < min_epoch; it++)  delete it->map;
+        retired_.erase(retired_.begin(), it);
+    }
+};
+
+#endif
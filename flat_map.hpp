@@ -0,0 +1,399 @@
+#ifndef _FLAT_MAP_HPP
+#define _FLAT_MAP_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * Class implementing a sorted associative container over contiguous storage.
+ *
+ * Keys and values are kept in two separate arrays sorted by key, so lookups are binary searches
+ * over a dense key array instead of pointer chasing through tree nodes. Insertions and erasures
+ * shift the following elements, and invalidate all the iterators. The interface mirrors the
+ * subset of std::map used by interval_map, so it can be used as its container.
+ *
+ * @tparam Key The type of the key
+ * @tparam T The type of the values
+ * @tparam Compare Callable defining a strict weak ordering for the keys
+ * @tparam KeyContainer Contiguous container storing the keys
+ * @tparam MappedContainer Contiguous container storing the values
+ */
+template<
+    class Key,
+    class T,
+    class Compare = std::less<Key>,
+    class KeyContainer = std::vector<Key>,
+    class MappedContainer = std::vector<T>
+>
+class flat_map
+{
+public:
+    using key_container_type = KeyContainer;
+    using mapped_container_type = MappedContainer;
+    using key_type = Key;
+    using mapped_type = T;
+    using value_type = std::pair<Key, T>;
+    using key_compare = Compare;
+    using allocator_type = typename MappedContainer::allocator_type;
+    using reference = std::pair<const Key&, T&>;
+    using const_reference = std::pair<const Key&, const T&>;
+    using size_type = std::size_t;
+    using difference_type = std::ptrdiff_t;
+
+    /**
+     * Pointer-like wrapper returned by the iterators' `operator->`.
+     *
+     * Elements are not stored as pairs, so the iterators return the reference by value and this
+     * class keeps it alive for the duration of the member access.
+     */
+    template<class Reference>
+    struct arrow_proxy
+    {
+        Reference ref;
+
+        Reference* operator->() noexcept { return &ref; }
+    };
+
+    using pointer = arrow_proxy<reference>;
+    using const_pointer = arrow_proxy<const_reference>;
+
+private:
+    template<bool Const>
+    class iterator_base
+    {
+        friend class flat_map;
+        template<bool> friend class iterator_base;
+
+        using key_iterator = typename KeyContainer::const_iterator;
+        using mapped_iterator = std::conditional_t<
+            Const,
+            typename MappedContainer::const_iterator,
+            typename MappedContainer::iterator
+        >;
+
+        key_iterator k_{};
+        mapped_iterator v_{};
+
+        iterator_base(key_iterator k, mapped_iterator v) : k_(k), v_(v) {}
+
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = typename flat_map::value_type;
+        using difference_type = typename flat_map::difference_type;
+        using reference = std::conditional_t<Const, typename flat_map::const_reference, typename flat_map::reference>;
+        using pointer = arrow_proxy<reference>;
+
+        iterator_base() = default;
+
+        /**
+         * Converts an iterator into a const_iterator.
+         */
+        template<bool C = Const, class = std::enable_if_t<C>>
+        iterator_base(const iterator_base<false>& other) : k_(other.k_), v_(other.v_) {}
+
+        reference operator*() const { return reference(*k_, *v_); }
+        pointer operator->() const { return pointer{ **this }; }
+        reference operator[](difference_type n) const { return *(*this + n); }
+
+        iterator_base& operator++() { ++k_; ++v_; return *this; }
+        iterator_base operator++(int) { iterator_base tmp = *this; ++*this; return tmp; }
+        iterator_base& operator--() { --k_; --v_; return *this; }
+        iterator_base operator--(int) { iterator_base tmp = *this; --*this; return tmp; }
+        iterator_base& operator+=(difference_type n) { k_ += n; v_ += n; return *this; }
+        iterator_base& operator-=(difference_type n) { k_ -= n; v_ -= n; return *this; }
+
+        friend iterator_base operator+(iterator_base it, difference_type n) { return it += n; }
+        friend iterator_base operator+(difference_type n, iterator_base it) { return it += n; }
+        friend iterator_base operator-(iterator_base it, difference_type n) { return it -= n; }
+        friend difference_type operator-(const iterator_base& lhs, const iterator_base& rhs) { return lhs.k_ - rhs.k_; }
+
+        friend bool operator==(const iterator_base& lhs, const iterator_base& rhs) { return lhs.k_ == rhs.k_; }
+        friend bool operator!=(const iterator_base& lhs, const iterator_base& rhs) { return lhs.k_ != rhs.k_; }
+        friend bool operator<(const iterator_base& lhs, const iterator_base& rhs) { return lhs.k_ < rhs.k_; }
+        friend bool operator<=(const iterator_base& lhs, const iterator_base& rhs) { return lhs.k_ <= rhs.k_; }
+        friend bool operator>(const iterator_base& lhs, const iterator_base& rhs) { return lhs.k_ > rhs.k_; }
+        friend bool operator>=(const iterator_base& lhs, const iterator_base& rhs) { return lhs.k_ >= rhs.k_; }
+    };
+
+public:
+    using iterator = iterator_base<false>;
+    using const_iterator = iterator_base<true>;
+    using reverse_iterator = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+protected:
+    /**
+     * Keys, sorted according to comp_.
+     */
+    KeyContainer keys_{};
+
+    /**
+     * Values, where values_[i] is the value mapped to keys_[i].
+     */
+    MappedContainer values_{};
+
+    /**
+     * Key comparator.
+     */
+    Compare comp_{};
+
+public:
+    /**
+     * Constructor.
+     */
+    flat_map() {}
+
+    /**
+     * Constructor.
+     *
+     * @param comp comparator used to order the keys
+     */
+    explicit flat_map(const Compare& comp) : comp_(comp) {}
+
+    /**
+     * Constructor.
+     *
+     * As in std::map, if multiple elements have equivalent keys only the first one is kept.
+     *
+     * @param first iterator to the first element of the range
+     * @param last iterator past the last element of the range
+     * @param comp comparator used to order the keys
+     */
+    template<class InputIt>
+    flat_map(InputIt first, InputIt last, const Compare& comp = Compare()) :
+        comp_(comp)
+    {
+        std::vector<value_type> elements(first, last);
+        std::stable_sort(elements.begin(), elements.end(), [this](const value_type& a, const value_type& b) {
+            return comp_(a.first, b.first);
+        });
+
+        keys_.reserve(elements.size());
+        values_.reserve(elements.size());
+
+        for (auto& element : elements) {
+            if (!keys_.empty() && !comp_(keys_.back(), element.first))  continue;
+            keys_.push_back(std::move(element.first));
+            values_.push_back(std::move(element.second));
+        }
+    }
+
+    /**
+     * Constructor.
+     *
+     * @param init initializer list of the elements
+     * @param comp comparator used to order the keys
+     */
+    flat_map(std::initializer_list<value_type> init, const Compare& comp = Compare()) :
+        flat_map(init.begin(), init.end(), comp)
+    {}
+
+    iterator begin() noexcept { return iterator(keys_.cbegin(), values_.begin()); }
+    const_iterator begin() const noexcept { return const_iterator(keys_.cbegin(), values_.cbegin()); }
+    iterator end() noexcept { return iterator(keys_.cend(), values_.end()); }
+    const_iterator end() const noexcept { return const_iterator(keys_.cend(), values_.cend()); }
+    reverse_iterator rbegin() noexcept { return reverse_iterator(end()); }
+    const_reverse_iterator rbegin() const noexcept { return const_reverse_iterator(end()); }
+    reverse_iterator rend() noexcept { return reverse_iterator(begin()); }
+    const_reverse_iterator rend() const noexcept { return const_reverse_iterator(begin()); }
+
+    const_iterator cbegin() const noexcept { return begin(); }
+    const_iterator cend() const noexcept { return end(); }
+    const_reverse_iterator crbegin() const noexcept { return rbegin(); }
+    const_reverse_iterator crend() const noexcept { return rend(); }
+
+    [[nodiscard]] bool empty() const noexcept { return keys_.empty(); }
+    size_type size() const noexcept { return keys_.size(); }
+    size_type max_size() const noexcept
+    {
+        return std::min<size_type>(keys_.max_size(), values_.max_size());
+    }
+
+    allocator_type get_allocator() const { return values_.get_allocator(); }
+
+    /**
+     * Reserves storage for at least `n` elements.
+     *
+     * @param n number of elements
+     */
+    void reserve(size_type n)
+    {
+        keys_.reserve(n);
+        values_.reserve(n);
+    }
+
+    /**
+     * Removes all the elements.
+     */
+    void clear() noexcept
+    {
+        keys_.clear();
+        values_.clear();
+    }
+
+    key_compare key_comp() const { return comp_; }
+
+    /**
+     * Returns the sorted key array.
+     *
+     * @return a const reference to the key container
+     */
+    const KeyContainer& keys() const noexcept { return keys_; }
+
+    /**
+     * Returns the value array, in the same order as the keys.
+     *
+     * @return a const reference to the value container
+     */
+    const MappedContainer& values() const noexcept { return values_; }
+
+    iterator lower_bound(const key_type& key)
+    {
+        return to_iterator(std::lower_bound(keys_.cbegin(), keys_.cend(), key, comp_));
+    }
+
+    const_iterator lower_bound(const key_type& key) const
+    {
+        return to_iterator(std::lower_bound(keys_.cbegin(), keys_.cend(), key, comp_));
+    }
+
+    iterator upper_bound(const key_type& key)
+    {
+        return to_iterator(std::upper_bound(keys_.cbegin(), keys_.cend(), key, comp_));
+    }
+
+    const_iterator upper_bound(const key_type& key) const
+    {
+        return to_iterator(std::upper_bound(keys_.cbegin(), keys_.cend(), key, comp_));
+    }
+
+    iterator find(const key_type& key)
+    {
+        iterator it = lower_bound(key);
+        return (it == end() || comp_(key, it->first) ? end() : it);
+    }
+
+    const_iterator find(const key_type& key) const
+    {
+        const_iterator it = lower_bound(key);
+        return (it == end() || comp_(key, it->first) ? end() : it);
+    }
+
+    size_type count(const key_type& key) const { return (find(key) == end() ? 0 : 1); }
+
+    /**
+     * Inserts an element constructed from `key` and `obj`, if the key does not exist yet.
+     *
+     * The insertion takes place before `hint` if that is the right position, otherwise the
+     * position is found with a binary search.
+     *
+     * @param hint iterator to the position before which the element should be inserted
+     * @param key the key of the element
+     * @param obj the value of the element
+     * @return an iterator to the inserted element, or to the element with an equivalent key
+     */
+    template<class K, class M>
+    iterator emplace_hint(const_iterator hint, K&& key, M&& obj)
+    {
+        auto kt = hint.k_;
+
+        // Check that hint is the lower bound of key, otherwise search it
+        if ((kt != keys_.cbegin() && !comp_(*std::prev(kt), key)) ||
+            (kt != keys_.cend() && comp_(*kt, key))) {
+            kt = std::lower_bound(keys_.cbegin(), keys_.cend(), key, comp_);
+        }
+
+        if (kt != keys_.cend() && !comp_(key, *kt))  return to_iterator(kt);
+
+        const difference_type pos = kt - keys_.cbegin();
+        keys_.emplace(kt, std::forward<K>(key));
+
+        // The arrays keep the same size if the value cannot be inserted
+        try {
+            values_.emplace(values_.cbegin() + pos, std::forward<M>(obj));
+        }
+        catch (...) {
+            keys_.erase(keys_.cbegin() + pos);
+            throw;
+        }
+        return begin() + pos;
+    }
+
+    template<class K, class M>
+    std::pair<iterator, bool> emplace(K&& key, M&& obj)
+    {
+        const size_type n = size();
+        iterator it = emplace_hint(lower_bound(key), std::forward<K>(key), std::forward<M>(obj));
+        return { it, size() != n };
+    }
+
+    std::pair<iterator, bool> insert(const value_type& value) { return emplace(value.first, value.second); }
+    std::pair<iterator, bool> insert(value_type&& value) { return emplace(std::move(value.first), std::move(value.second)); }
+
+    iterator erase(const_iterator pos)
+    {
+        const difference_type n = pos - cbegin();
+        keys_.erase(pos.k_);
+        values_.erase(pos.v_);
+        return begin() + n;
+    }
+
+    iterator erase(const_iterator first, const_iterator last)
+    {
+        const difference_type n = first - cbegin();
+        keys_.erase(first.k_, last.k_);
+        values_.erase(first.v_, last.v_);
+        return begin() + n;
+    }
+
+    size_type erase(const key_type& key)
+    {
+        const_iterator it = find(key);
+        if (it == end())  return 0;
+        erase(it);
+        return 1;
+    }
+
+    void swap(flat_map& other)
+    {
+        using std::swap;
+        swap(keys_, other.keys_);
+        swap(values_, other.values_);
+        swap(comp_, other.comp_);
+    }
+
+    friend bool operator==(const flat_map& lhs, const flat_map& rhs)
+    {
+        return lhs.keys_ == rhs.keys_ && lhs.values_ == rhs.values_;
+    }
+
+    friend bool operator!=(const flat_map& lhs, const flat_map& rhs) { return !(lhs == rhs); }
+
+    friend bool operator<(const flat_map& lhs, const flat_map& rhs)
+    {
+        return std::lexicographical_compare(lhs.begin(), lhs.end(), rhs.begin(), rhs.end());
+    }
+
+    friend bool operator<=(const flat_map& lhs, const flat_map& rhs) { return !(rhs < lhs); }
+    friend bool operator>(const flat_map& lhs, const flat_map& rhs) { return rhs < lhs; }
+    friend bool operator>=(const flat_map& lhs, const flat_map& rhs) { return !(lhs < rhs); }
+
+private:
+    iterator to_iterator(typename KeyContainer::const_iterator kt)
+    {
+        return begin() + (kt - keys_.cbegin());
+    }
+
+    const_iterator to_iterator(typename KeyContainer::const_iterator kt) const
+    {
+        return begin() + (kt - keys_.cbegin());
+    }
+};
+
+#endif
@@ -0,0 +1,268 @@
+#ifndef _FROZEN_INTERVAL_MAP_HPP
+#define _FROZEN_INTERVAL_MAP_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <stdexcept>
+#include <vector>
+
+#include "interval_map.hpp"
+
+/**
+ * Allocator returning memory aligned to a cache line.
+ *
+ * @tparam T The type of the elements
+ * @tparam Alignment The alignment in bytes
+ */
+template<class T, std::size_t Alignment = 64>
+struct cache_aligned_allocator
+{
+    using value_type = T;
+
+    template<class U>
+    struct rebind { using other = cache_aligned_allocator<U, Alignment>; };
+
+    cache_aligned_allocator() noexcept {}
+
+    template<class U>
+    cache_aligned_allocator(const cache_aligned_allocator<U, Alignment>&) noexcept {}
+
+    T* allocate(std::size_t n)
+    {
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Alignment)));
+    }
+
+    void deallocate(T* p, std::size_t) noexcept
+    {
+        ::operator delete(p, std::align_val_t(Alignment));
+    }
+
+    template<class U>
+    bool operator==(const cache_aligned_allocator<U, Alignment>&) const noexcept { return true; }
+
+    template<class U>
+    bool operator!=(const cache_aligned_allocator<U, Alignment>&) const noexcept { return false; }
+};
+
+/**
+ * Class implementing an immutable snapshot of an interval map, optimized for lookups.
+ *
+ * The keys are laid out in Eytzinger order (the breadth-first order of a complete binary search
+ * tree) in a cache-line-aligned array, so the first levels of every search share the same few
+ * cache lines, and the lines of the next levels can be prefetched. The search loop does not
+ * branch on the comparisons, and the number of iterations differs by at most one between keys,
+ * which keeps the lookup latency predictable.
+ *
+ * @tparam Key The type of the key
+ * @tparam T The type of the values
+ * @tparam Compare Callable defining a strict weak ordering for the keys
+ */
+template<class Key, class T, class Compare = std::less<Key>>
+class frozen_interval_map
+{
+public:
+    using key_type = Key;
+    using mapped_type = T;
+    using key_compare = Compare;
+    using size_type = std::size_t;
+
+    /**
+     * Number of searches interleaved by `at_many`.
+     */
+    static constexpr size_type lookup_group_size = 32;
+
+protected:
+    /**
+     * Keys in Eytzinger order.
+     *
+     * The root is at index 1, and the children of the node at index k are at 2k and 2k + 1.
+     * Index 0 is unused.
+     */
+    std::vector<Key, cache_aligned_allocator<Key>> keys_{};
+
+    /**
+     * Values, where values_[k] is the value of keys_[k], and values_[0] is the first value.
+     */
+    std::vector<T> values_{};
+
+    /**
+     * Has first value.
+     *
+     * True if the snapshotted map had a first value, false otherwise.
+     */
+    bool has_first_val_{ false };
+
+    /**
+     * Key comparator.
+     */
+    Compare comp_{};
+
+public:
+    /**
+     * Constructor.
+     *
+     * @param imap the interval map to be snapshotted
+     */
+    template<class Allocator, class Container>
+    explicit frozen_interval_map(const interval_map<Key, T, Compare, Allocator, Container>& imap) :
+        keys_(imap.size() + 1),
+        values_(imap.size() + 1),
+        has_first_val_(imap.has_first_val()),
+        comp_(imap.key_comp())
+    {
+        if (has_first_val_)  values_[0] = imap.get_first_val();
+
+        auto it = imap.begin();
+        build(it, 1);
+    }
+
+    size_type size() const noexcept { return keys_.size() - 1; }
+
+    /**
+     * Checks whether the first value is set.
+     *
+     * @return true if a first value has been assigned, false otherwise
+     */
+    bool has_first_val() const noexcept { return has_first_val_; }
+
+    /**
+     * Returns a const reference to the value that is mapped to a key equivalent to `key`.
+     *
+     * @param key the key of the element to find
+     * @return a const reference to the same value that the snapshotted map returns for `key`
+     */
+    const mapped_type& at(const key_type& key) const
+    {
+        const size_type k = find(key);
+
+        if (k == 0 && !has_first_val_)  throw std::out_of_range("frozen_interval_map::at");
+        return values_[k];
+    }
+
+    /**
+     * Looks up a sequence of keys in any order, writing the value mapped to each of them to `out`.
+     *
+     * The keys are searched in groups of `lookup_group_size` interleaved searches, each step of
+     * a search prefetching the node it visits next while the other searches of the group step,
+     * so the cache misses of the group overlap. The values are prefetched the same way before
+     * being written.
+     *
+     * @param first iterator to the first key
+     * @param last iterator past the last key
+     * @param out output iterator receiving the mapped values
+     * @return the output iterator past the last value written
+     */
+    template<class ForwardIt, class OutputIt>
+    OutputIt at_many(ForwardIt first, ForwardIt last, OutputIt out) const
+    {
+        const size_type n = size();
+        const Key* keys = keys_.data();
+        size_type depth = 0;
+        while ((size_type(2) << depth) - 1 <= n)  depth++;
+        ForwardIt group[lookup_group_size];
+        size_type positions[lookup_group_size];
+
+        while (first != last) {
+            size_type m = 0;
+            for (; m < lookup_group_size && first != last; ++first, ++m) {
+                group[m] = first;
+                positions[m] = 1;
+            }
+
+            // The searches go down the `depth` complete levels of the tree in lockstep, and some
+            // of them then reach the last, incomplete level
+            for (size_type level = 0; level < depth; level++) {
+                for (size_type j = 0; j < m; j++) {
+                    size_type& k = positions[j];
+                    k = 2 * k + !comp_(*group[j], keys[k]);
+#if defined(__GNUC__)
+                    __builtin_prefetch(keys + std::min(k, n));
+#endif
+                }
+            }
+            for (size_type j = 0; j < m; j++) {
+                size_type& k = positions[j];
+                if (k <= n)  k = 2 * k + !comp_(*group[j], keys[k]);
+            }
+
+            for (size_type j = 0; j < m; j++) {
+                positions[j] = last_right_turn(positions[j]);
+#if defined(__GNUC__)
+                __builtin_prefetch(values_.data() + positions[j]);
+#endif
+            }
+
+            for (size_type j = 0; j < m; j++, ++out) {
+                if (positions[j] == 0 && !has_first_val_)  throw std::out_of_range("frozen_interval_map::at_many");
+                *out = values_[positions[j]];
+            }
+        }
+        return out;
+    }
+
+private:
+    /**
+     * Number of keys in a cache line, i.e. the number of tree levels spanned by a prefetch.
+     */
+    static constexpr size_type keys_per_line = std::max<size_type>(1, 64 / sizeof(Key));
+
+    /**
+     * Fills the subtree rooted at `k` in order, consuming the sorted elements from `it`.
+     */
+    template<class InputIt>
+    void build(InputIt& it, size_type k)
+    {
+        if (k >= keys_.size())  return;
+
+        build(it, 2 * k);
+        keys_[k] = it->first;
+        values_[k] = it->second;
+        ++it;
+        build(it, 2 * k + 1);
+    }
+
+    /**
+     * Finds the position of the greatest key that is not greater than `key`.
+     *
+     * The search goes right whenever the node's key is not greater than `key`, so the answer
+     * is the last node where it went right: its index is obtained by dropping the trailing
+     * left turns (zero bits) and the right turn itself from the final index.
+     *
+     * @return the Eytzinger index of the key, or 0 if all the keys are greater than `key`
+     */
+    size_type find(const key_type& key) const
+    {
+        const size_type n = size();
+        const Key* keys = keys_.data();
+        size_type k = 1;
+
+        while (k <= n) {
+#if defined(__GNUC__)
+            __builtin_prefetch(keys + std::min(k * keys_per_line, n));
+#endif
+            k = 2 * k + !comp_(key, keys[k]);
+        }
+
+        return last_right_turn(k);
+    }
+
+    /**
+     * Returns the index of the last node where a search ending at index `k` went right.
+     */
+    static size_type last_right_turn(size_type k) noexcept
+    {
+#if defined(__GNUC__)
+        return k >> (__builtin_ctzll(k) + 1);
+#else
+        while ((k & 1) == 0)  k >>= 1;
+        return k >> 1;
+#endif
+    }
+};
+
+template<class Key, class T, class Compare, class Allocator, class Container>
+frozen_interval_map(const interval_map<Key, T, Compare, Allocator, Container>&) -> frozen_interval_map<Key, T, Compare>;
+
+#endif
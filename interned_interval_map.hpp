@@ -0,0 +1,195 @@
+#ifndef _INTERNED_INTERVAL_MAP_HPP
+#define _INTERNED_INTERVAL_MAP_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "interval_map.hpp"
+
+/**
+ * Class implementing an interval map that stores each distinct value only once.
+ *
+ * Values are interned in a table, and the intervals map keys to the small integer ids of the
+ * values. Assigning a value costs a hash lookup, after which all the copies made by the interval
+ * map and the equality checks used to coalesce intervals work on ids only. This is convenient
+ * when the values are large and few of them are distinct.
+ *
+ * Values are kept, with their ids, after the last interval mapping them is overwritten, until
+ * `compact` removes them. `compact` also renumbers the remaining values, so an id obtained from
+ * the map is only valid until the next call to `compact`.
+ *
+ * @tparam Key The type of the key
+ * @tparam T The type of the values
+ * @tparam Compare Callable defining a strict weak ordering for the keys
+ * @tparam Hash Callable hashing the values
+ * @tparam Id Unsigned integer type of the ids
+ */
+template<
+    class Key,
+    class T,
+    class Compare = std::less<Key>,
+    class Hash = std::hash<T>,
+    class Id = std::uint32_t
+>
+class interned_interval_map
+{
+public:
+    using map_type = interval_map<Key, Id, Compare>;
+    using key_type = Key;
+    using mapped_type = T;
+    using id_type = Id;
+    using size_type = std::size_t;
+
+protected:
+    /**
+     * Ids of the interned values.
+     */
+    std::unordered_map<T, Id, Hash> ids_{};
+
+    /**
+     * Interned values, where values_[id] points to the value with such id in ids_.
+     */
+    std::vector<const T*> values_{};
+
+    /**
+     * Interval map of the ids.
+     */
+    map_type map_{};
+
+public:
+    /**
+     * Constructor.
+     *
+     * @param first_val default value to which keys map if no match is found in the map.
+     */
+    explicit interned_interval_map(const T& first_val)
+    {
+        map_.set_first_val(intern(first_val));
+    }
+
+    interned_interval_map(const interned_interval_map&) = delete;
+    interned_interval_map& operator=(const interned_interval_map&) = delete;
+
+    /**
+     * Returns the interval map of the ids.
+     *
+     * @return a const reference to the map
+     */
+    const map_type& ids() const noexcept { return map_; }
+
+    /**
+     * Returns the number of intervals.
+     */
+    size_type size() const { return map_.size(); }
+
+    /**
+     * Returns the number of interned values.
+     */
+    size_type distinct_values() const noexcept { return values_.size(); }
+
+    /**
+     * Returns the value with id `id`.
+     *
+     * @param id the id of the value
+     * @return a const reference to the value
+     */
+    const mapped_type& value(id_type id) const { return *values_.at(id); }
+
+    /**
+     * Sets the first value.
+     *
+     * @param val value to be assigned
+     */
+    void set_first_val(const mapped_type& val) { map_.set_first_val(intern(val)); }
+
+    /**
+     * Returns a const reference to the first value.
+     */
+    const mapped_type& get_first_val() const { return *values_[map_.get_first_val()]; }
+
+    /**
+     * Manually inserts a pair to the map.
+     *
+     * @param key the key to which the value maps
+     * @param val the value to be assigned
+     */
+    void insert(const key_type& key, const mapped_type& val) { map_.insert(key, intern(val)); }
+
+    /**
+     * Assigns `val` to the interval [`key_begin`, `key_end`).
+     *
+     * @param key_begin the first key (included) of the interval
+     * @param key_end the last key (excluded) of the interval
+     * @param val the value to be assigned
+     */
+    void insert_range(const key_type& key_begin, const key_type& key_end, const mapped_type& val)
+    {
+        map_.insert_range(key_begin, key_end, intern(val));
+    }
+
+    /**
+     * Returns a const reference to the value that is mapped to a key equivalent to `key`.
+     *
+     * @param key the key of the element to find
+     * @return a const reference to the mapped value
+     */
+    const mapped_type& at(const key_type& key) const { return *values_[map_.at(key)]; }
+
+    /**
+     * Removes the interned values that are no longer mapped by any interval, and renumbers the
+     * remaining ones.
+     */
+    void compact()
+    {
+        constexpr id_type unused = std::numeric_limits<id_type>::max();
+        std::vector<id_type> new_ids(values_.size(), unused);
+        std::vector<const T*> values;
+
+        auto renumber = [&](id_type id) {
+            if (new_ids[id] == unused) {
+                new_ids[id] = static_cast<id_type>(values.size());
+                values.push_back(values_[id]);
+            }
+            return new_ids[id];
+        };
+
+        // Renumbering is a bijection on the used ids, so no interval needs to be coalesced. The
+        // first value is set last, as set_first_val compares it with the first interval.
+        const id_type first_id = renumber(map_.get_first_val());
+        for (auto it = map_.begin(); it != map_.end(); it++)  it->second = renumber(it->second);
+        map_.set_first_val(first_id);
+
+        for (std::size_t id = 0; id < new_ids.size(); id++) {
+            if (new_ids[id] == unused)  ids_.erase(ids_.find(*values_[id]));
+            else  ids_.find(*values_[id])->second = new_ids[id];
+        }
+        values_ = std::move(values);
+    }
+
+private:
+    /**
+     * Returns the id of `val`, interning it if needed.
+     */
+    id_type intern(const mapped_type& val)
+    {
+        auto it = ids_.find(val);
+        if (it != ids_.end())  return it->second;
+
+        if (values_.size() >= std::numeric_limits<id_type>::max()) {
+            throw std::length_error("interned_interval_map::intern");
+        }
+
+        values_.reserve(values_.size() + 1);
+        it = ids_.emplace(val, static_cast<id_type>(values_.size())).first;
+        values_.push_back(&it->first);
+        return it->second;
+    }
+};
+
+#endif
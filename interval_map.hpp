@@ -1,8 +1,42 @@
 #ifndef _INTERVAL_MAP_HPP
 #define _INTERVAL_MAP_HPP
 
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <iterator>
 #include <map>
+#include <optional>
+#include <queue>
 #include <stdexcept>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "flat_map.hpp"
+#include "interval_map_stats.hpp"
+
+// INTERVAL_MAP_STATS adds a member to interval_map, so it must be defined the same way in every
+// translation unit of a program: otherwise the units disagree on the layout of the same class,
+// which is undefined behavior (an ODR violation) that the linker does not report. MSVC can at
+// least check it at link time.
+#if defined(_MSC_VER)
+#ifdef INTERVAL_MAP_STATS
+#pragma detect_mismatch("INTERVAL_MAP_STATS", "1")
+#else
+#pragma detect_mismatch("INTERVAL_MAP_STATS", "0")
+#endif
+#endif
+
+#ifdef INTERVAL_MAP_STATS
+#define INTERVAL_MAP_COUNT(counter, n) (stats_.counter += (n))
+#define INTERVAL_MAP_COUNT_SCOPE(operation) interval_map_stats::scope stats_scope(stats_, stats_.operation)
+#else
+#define INTERVAL_MAP_COUNT(counter, n) ((void)0)
+#define INTERVAL_MAP_COUNT_SCOPE(operation) ((void)0)
+#endif
 
 /**
  * Class implementing interval map.
@@ -85,8 +119,11 @@ public:
     using const_iterator = typename Container::const_iterator;
     using reverse_iterator = typename Container::reverse_iterator;
     using const_reverse_iterator = typename Container::const_reverse_iterator;
-    using node_type = typename Container::node_type;
-    using insert_return_type = typename Container::insert_return_type;
+
+    /**
+     * Number of searches interleaved by `at_many_unsorted`.
+     */
+    static constexpr size_type lookup_group_size = 32;
 
 protected:
     /**
@@ -110,6 +147,16 @@ protected:
      */
     Container c_{};
 
+#ifdef INTERVAL_MAP_STATS
+    /**
+     * Counters of the work done by the map.
+     *
+     * This member only exists when INTERVAL_MAP_STATS is defined, which must then be the case in
+     * every translation unit of the program (see the top of this file).
+     */
+    mutable interval_map_stats stats_{};
+#endif
+
 public:
     /**
      * Constructor.
@@ -142,7 +189,22 @@ public:
      * Constructor.
      *
      * @param first_val default value to which keys map if no match is found in the map.
-     * @param c container to be assigned
+     * @param c container to be moved
+     */
+    interval_map(const T& first_val, Container&& c) :
+        first_val_(first_val),
+        has_first_val_(true),
+        c_(std::move(c))
+    {}
+
+    /**
+     * Constructor.
+     *
+     * The pairs may come in any order, and are sorted by the container; of pairs with
+     * equivalent keys, the first one is kept.
+     *
+     * @param first_val default value to which keys map if no match is found in the map.
+     * @param init pairs to be inserted
      */
     interval_map(const T& first_val, std::initializer_list<value_type> init) :
         first_val_(first_val),
@@ -150,6 +212,51 @@ public:
         c_(Container(init))
     {}
 
+    /**
+     * Constructor.
+     *
+     * Builds the map in linear time from pairs sorted by strictly increasing key. The pairs
+     * whose value is equal to the value of the previous pair (or to `first_val` for the first
+     * one) are dropped, as they do not start a new interval.
+     *
+     * @param first_val default value to which keys map if no match is found in the map.
+     * @param first iterator to the first pair
+     * @param last iterator past the last pair
+     */
+    template<class InputIt, class = typename std::iterator_traits<InputIt>::iterator_category>
+    interval_map(const T& first_val, InputIt first, InputIt last) :
+        first_val_(first_val),
+        has_first_val_(true)
+    {
+        using input_category = typename std::iterator_traits<InputIt>::iterator_category;
+        using category = typename std::iterator_traits<iterator>::iterator_category;
+
+        // Contiguous containers are allocated once, possibly larger than needed if pairs are dropped
+        if constexpr (std::is_base_of_v<std::random_access_iterator_tag, category> &&
+            std::is_base_of_v<std::forward_iterator_tag, input_category>) {
+            c_.reserve(static_cast<size_type>(std::distance(first, last)));
+        }
+
+        // Last key dropped since the last pair inserted, to check the order of the next keys
+        std::optional<key_type> dropped_key;
+
+        for (; first != last; ++first) {
+            const auto& pair = *first;
+            if ((dropped_key && !key_comp_(*dropped_key, pair.first)) ||
+                (!c_.empty() && !key_comp_(std::prev(c_.end())->first, pair.first))) {
+                throw std::invalid_argument("interval_map::interval_map");
+            }
+
+            if (pair.second == (c_.empty() ? first_val_ : std::prev(c_.end())->second)) {
+                dropped_key = pair.first;
+                continue;
+            }
+
+            c_.emplace_hint(c_.end(), pair.first, pair.second);
+            dropped_key.reset();
+        }
+    }
+
     iterator begin() noexcept { return c_.begin(); }
     const_iterator begin() const noexcept { return c_.begin(); }
     iterator end() noexcept { return c_.end(); }
@@ -164,11 +271,27 @@ public:
     const_reverse_iterator crbegin() const noexcept { return c_.crbegin(); }
     const_reverse_iterator crend() const noexcept { return c_.crend(); }
 
+    iterator lower_bound(const key_type& key) { return c_.lower_bound(key); }
+    const_iterator lower_bound(const key_type& key) const { return c_.lower_bound(key); }
+    iterator upper_bound(const key_type& key) { return c_.upper_bound(key); }
+    const_iterator upper_bound(const key_type& key) const { return c_.upper_bound(key); }
+
     [[nodiscard]] bool empty() const noexcept {
         return (has_first_val_ ? false : c_.empty());
     }
     size_type size() const { return c_.size(); }
     size_type max_size() const { return c_.max_size(); }
+    allocator_type get_allocator() const { return c_.get_allocator(); }
+    key_compare key_comp() const { return c_.key_comp(); }
+
+#ifdef INTERVAL_MAP_STATS
+    /**
+     * Returns the counters of the work done by the map.
+     */
+    const interval_map_stats& stats() const noexcept { return stats_; }
+
+    void reset_stats() noexcept { stats_ = interval_map_stats(); }
+#endif
 
     /**
      * Sets the first value.
@@ -194,6 +317,13 @@ public:
      */
     void reset_first_val() { has_first_val_ = false; }
 
+    /**
+     * Checks whether the first value is set.
+     *
+     * @return true if a first value has been assigned, false otherwise
+     */
+    bool has_first_val() const noexcept { return has_first_val_; }
+
     /**
      * Returns a const reference to the first value.
      *
@@ -213,27 +343,31 @@ public:
      */
     void insert(const key_type& key, const mapped_type& val)
     {
+        INTERVAL_MAP_COUNT_SCOPE(inserts);
+
         // If the map is empty and value is equal to first_val_, do nothing
-        if (c_.empty() && has_first_val_ && val == first_val_)  return;
+        if (c_.empty() && has_first_val_ && equal_values(val, first_val_))  return;
 
         // Find the position of the upper bound of key
         iterator it = c_.upper_bound(key);
 
         // Insert the value of key_end (emplace_hint is faster than insert_or_assign)
-        it = c_.emplace_hint(it, key, val);
+        it = emplace_before(it, key, val);
         // Make sure the value is assigned if the key already exists
         it->second = val;
+        INTERVAL_MAP_COUNT(value_copies, 1);
 
         // Get the value of the element that comes before key
         mapped_type prev_val = (it == c_.begin() ? first_val_ : std::prev(it)->second);
+        INTERVAL_MAP_COUNT(value_copies, 1);
 
         // If the previous value doesn't exist, or the value is different from the previous value,
         // move forward, otherwise erase the current value.
-        if ((it == c_.begin() && !has_first_val_) || (val != prev_val)) {
+        if ((it == c_.begin() && !has_first_val_) || !equal_values(val, prev_val)) {
             it++;
         }
         else {
-            it = c_.erase(it);
+            it = erase_coalesced(it);
         }
 
         // Exit if the current element is the end
@@ -245,11 +379,12 @@ public:
 
         // Get the value of the element that comes before the current element
         prev_val = (it == c_.begin() ? first_val_ : std::prev(it)->second);
+        INTERVAL_MAP_COUNT(value_copies, 1);
 
         // Erase the current element if its value is equal to the value of
         // the previous element, and the previous element exists
-        if (it->second == prev_val) {
-            c_.erase(it);
+        if (equal_values(it->second, prev_val)) {
+            erase_coalesced(it);
         }
     }
 
@@ -262,53 +397,155 @@ public:
      */
     void insert_range(const key_type& key_begin, const key_type& key_end, const mapped_type& val)
     {
-        // If the interval is empty, do nothing
-        if (key_begin >= key_end)  return;
+        insert_range(key_begin, key_end, val, [this](const key_type& key) { return c_.upper_bound(key); });
+    }
 
-        // If the map is empty and value is equal to first_val_, do nothing
-        if (c_.empty() && has_first_val_ && val == first_val_)  return;
+    /**
+     * Assigns a batch of intervals, with the same result as calling `insert_range` on each of
+     * them in order.
+     *
+     * Overlaps inside the batch are resolved first (later intervals overwrite earlier ones),
+     * then the resulting disjoint intervals are merged into the map. Small batches are applied
+     * one interval at a time, larger ones in a single linear pass over the map.
+     *
+     * @param first iterator to the first interval, a tuple-like (key_begin, key_end, val)
+     * @param last iterator past the last interval
+     */
+    template<class ForwardIt>
+    void insert_ranges(ForwardIt first, ForwardIt last)
+    {
+        check_previous_elements(first, last);
 
-        // Find the position of the upper bound of key_end
-        iterator jt = c_.upper_bound(key_end);
+        std::vector<run> runs = resolve_runs(first, last);
 
-        // Get the value to which key_end is mapped before the insertion
-        mapped_type prev_val = (jt == c_.begin() ? first_val_ : std::prev(jt)->second);
+        if (runs.empty())  return;
 
-        // Cannot assign the range if a previous element does not exist
-        if (jt == c_.begin() && !has_first_val_) {
-            throw std::out_of_range("interval_map::get_first_val");
-        }
+        using category = typename std::iterator_traits<iterator>::iterator_category;
 
-        // Insert the value of key_end (emplace_hint is faster than insert_or_assign)
-        jt = c_.emplace_hint(jt, key_end, prev_val);
-        // Make sure the value is assigned if the key already exists
-        jt->second = prev_val;
+        // Node-based containers favour applying few intervals in O(log n) each over rebuilding
+        // the whole container
+        if constexpr (!std::is_base_of_v<std::random_access_iterator_tag, category>) {
+            size_type log_size = 1;
+            for (size_type n = c_.size(); n > 1; n >>= 1)  log_size++;
 
-        // Insert the value of key_begin (emplace_hint is faster than insert_or_assign)
-        iterator it = c_.emplace_hint(jt, key_begin, val);
-        // Make sure the value is assigned if the key already exists
-        it->second = val;
+            // The runs are applied from the last one, which ends after the first key of a map
+            // without first value, each run then ending where the next one starts or after it
+            if (runs.size() * log_size < c_.size()) {
+                for (auto rt = runs.rbegin(); rt != runs.rend(); rt++)  insert_range(*rt->key_begin, *rt->key_end, *rt->val);
+                return;
+            }
+        }
 
-        // Get the value of the element that comes before key_begin
-        prev_val = (it == c_.begin() ? first_val_ : std::prev(it)->second);
+        merge_runs(runs);
+    }
 
-        // Erase all the previous values in the range (including key_begin
-        // if its value is equal to the value of its previous element)
-        if ((it == c_.begin() && !has_first_val_) || val != prev_val)  it++;
-        jt = c_.erase(it, jt);
+    /**
+     * Assigns a batch of intervals on `n_threads` threads, with the same result as calling
+     * `insert_range` on each of them in order.
+     *
+     * The key space is split into `n_threads` partitions at keys sampled from the batch. The
+     * intervals are clipped to the partitions they overlap, then each partition resolves its
+     * overlaps and merges them with its part of the map on its own thread. The partitions are
+     * finally joined in a linear pass, which drops the pairs repeating the value before them.
+     * The whole map is rebuilt, so this is meant for batches that are large compared to the map.
+     *
+     * @param first iterator to the first interval, a tuple-like (key_begin, key_end, val)
+     * @param last iterator past the last interval
+     * @param n_threads number of threads to use, 1 to run `insert_ranges(first, last)`
+     */
+    template<class ForwardIt>
+    void insert_ranges(ForwardIt first, ForwardIt last, std::size_t n_threads)
+    {
+        const std::size_t n = static_cast<std::size_t>(std::distance(first, last));
 
-        // If the current element is the beginning and there isn't a first value, no need to run
-        // the following lines.
-        if (jt == c_.begin() && !has_first_val_)  return;
+        // Small batches do not pay for starting the threads
+        n_threads = std::min(n_threads, n / 4096);
+        if (n_threads <= 1) {
+            insert_ranges(first, last);
+            return;
+        }
 
-        // Get the value of the element before the erased range
-        prev_val = (jt == c_.begin() ? first_val_ : std::prev(jt)->second);
+        check_previous_elements(first, last);
+
+        // Partition j covers the keys in [splitters[j - 1], splitters[j])
+        std::vector<key_type> splitters = sample_splitters(first, n, n_threads);
+        const std::size_t n_parts = splitters.size() + 1;
+
+        // Clip the intervals of each chunk of the batch to the partitions, keeping their order
+        std::vector<std::vector<std::vector<run>>> buckets(n_threads, std::vector<std::vector<run>>(n_parts));
+        run_parallel(n_threads, [&](std::size_t t) {
+            auto it = std::next(first, static_cast<difference_type>(n * t / n_threads));
+            const auto chunk_last = std::next(first, static_cast<difference_type>(n * (t + 1) / n_threads));
+
+            for (; it != chunk_last; ++it) {
+                const auto& op = *it;
+                const key_type& key_begin = std::get<0>(op);
+                const key_type& key_end = std::get<1>(op);
+                if (!key_comp_(key_begin, key_end))  continue;
+
+                const std::size_t part_first = static_cast<std::size_t>(std::upper_bound(splitters.begin(), splitters.end(), key_begin, c_.key_comp()) - splitters.begin());
+                const std::size_t part_last = static_cast<std::size_t>(std::lower_bound(splitters.begin(), splitters.end(), key_end, c_.key_comp()) - splitters.begin());
+
+                for (std::size_t j = part_first; j <= part_last; j++) {
+                    buckets[t][j].push_back({
+                        j == part_first ? &key_begin : &splitters[j - 1],
+                        j == part_last ? &key_end : &splitters[j],
+                        &std::get<2>(op)
+                    });
+                }
+            }
+        });
+
+        // Resolve the overlaps of each partition and merge it with its part of the map
+        std::vector<std::vector<run>> parts_runs(n_parts);
+        // The partitions get their own allocators, which may not be shared between threads
+        std::vector<Container> parts(n_parts, Container(c_.key_comp()));
+        std::vector<const mapped_type*> parts_prev_val(n_parts);
+        run_parallel(n_parts, [&](std::size_t j) {
+            std::vector<run> ops;
+            for (std::size_t t = 0; t < n_threads; t++) {
+                ops.insert(ops.end(), buckets[t][j].begin(), buckets[t][j].end());
+                std::vector<run>().swap(buckets[t][j]);
+            }
+            parts_runs[j] = sweep_runs(ops);
+
+            const const_iterator part_begin = (j == 0 ? c_.cbegin() : c_.lower_bound(splitters[j - 1]));
+            const const_iterator part_end = (j + 1 == n_parts ? c_.cend() : c_.lower_bound(splitters[j]));
+            parts_prev_val[j] = (part_begin != c_.cbegin() ? &std::prev(part_begin)->second : (has_first_val_ ? &first_val_ : nullptr));
+
+            merge_runs(parts[j], parts_runs[j], part_begin, part_end, parts_prev_val[j], j + 1 == n_parts ? nullptr : &splitters[j]);
+        });
+
+        // Join the partitions, each of which assumed that the keys before it kept their value
+        Container out = empty_container();
+        const mapped_type* prev_val = (has_first_val_ ? &first_val_ : nullptr);
+
+        for (std::size_t j = 0; j < n_parts; j++) {
+            auto it = parts[j].begin();
+
+            if (j > 0) {
+                const key_type& key = splitters[j - 1];
+                const mapped_type* part_prev_val = parts_prev_val[j];
+
+                if (it != parts[j].end() && !key_comp_(key, it->first)) {
+                    if (prev_val != nullptr && it->second == *prev_val)  it++;
+                }
+                else if (part_prev_val == nullptr) {
+                    // The previous partition ended with an interval whose end has no value
+                    if (prev_val != nullptr)  throw std::out_of_range("interval_map::get_first_val");
+                }
+                else if (prev_val == nullptr || !(*part_prev_val == *prev_val)) {
+                    out.emplace_hint(out.end(), key, *part_prev_val);
+                }
+            }
 
-        // If the value after the erased range is equal to the value before the
-        // erased range, erase it
-        if (jt->second == prev_val) {
-            c_.erase(jt);
+            for (; it != parts[j].end(); it++)  out.emplace_hint(out.end(), it->first, std::move(it->second));
+            Container().swap(parts[j]);
+
+            if (!out.empty())  prev_val = &std::prev(out.end())->second;
         }
+
+        c_.swap(out);
     }
 
     /**
@@ -317,12 +554,14 @@ public:
      * @param key the key of the element to find
      * @return a const reference to the mapped value of the existing element whose key is equivalent to `key`.
      */
-    const_reference at(const key_type& key) const
+    const mapped_type& at(const key_type& key) const
     {
-        iterator it = c_.upper_bound(key);
+        INTERVAL_MAP_COUNT_SCOPE(lookups);
+
+        const_iterator it = c_.upper_bound(key);
 
         if (it == c_.begin()) {
-            if (!has_first_val_)  std::out_of_range("interval_map::at");
+            if (!has_first_val_)  throw std::out_of_range("interval_map::at");
             return first_val_;
         }
         else {
@@ -330,6 +569,209 @@ public:
         }
     }
 
+    /**
+     * Position in an interval map from which the next lookup or assignment starts searching.
+     *
+     * A cursor remembers where its last operation ended, and searches from there, forward or
+     * backward, so operations on keys close to the previous one skip the search from the root:
+     * random access containers gallop in O(log d) for a distance of d elements, node-based
+     * containers step over up to a few elements before falling back to a search from the root.
+     *
+     * Modifying the map other than through the cursor, including through another cursor,
+     * invalidates it.
+     */
+    class cursor
+    {
+        interval_map* map_;
+
+        /**
+         * First element after the last key accessed.
+         */
+        iterator pos_;
+
+    public:
+        /**
+         * Constructor.
+         *
+         * @param imap the map on which the cursor operates
+         */
+        explicit cursor(interval_map& imap) : map_(&imap), pos_(imap.c_.begin()) {}
+
+        /**
+         * Returns a const reference to the value that is mapped to a key equivalent to `key`.
+         *
+         * @param key the key of the element to find
+         * @return a const reference to the mapped value
+         */
+        const mapped_type& at(const key_type& key) { return map_->at(pos_, key); }
+
+        /**
+         * Assigns `val` to the interval [`key_begin`, `key_end`).
+         *
+         * @param key_begin the first key (included) of the interval
+         * @param key_end the last key (excluded) of the interval
+         * @param val the value to be assigned
+         */
+        void insert_range(const key_type& key_begin, const key_type& key_end, const mapped_type& val)
+        {
+            pos_ = map_->insert_range(key_begin, key_end, val, [this](const key_type& key) {
+                return map_->finger_upper_bound(pos_, key);
+            });
+        }
+    };
+
+    /**
+     * Looks up a sequence of keys, writing the value mapped to each of them to `out`.
+     *
+     * The keys are expected in ascending order: each lookup then resumes from the interval found
+     * by the previous one, galloping forward on random access containers and stepping forward
+     * on node-based ones, so nearby keys cost amortised constant time. A key smaller than the
+     * previous one falls back to a search from the root.
+     *
+     * @param first iterator to the first key
+     * @param last iterator past the last key
+     * @param out output iterator receiving the mapped values
+     * @return the output iterator past the last value written
+     */
+    template<class InputIt, class OutputIt>
+    OutputIt at_many(InputIt first, InputIt last, OutputIt out) const
+    {
+        const_iterator it = c_.cbegin();
+
+        for (; first != last; ++first) {
+            const key_type& key = *first;
+
+            if (it != c_.cbegin() && key_comp_(key, std::prev(it)->first)) {
+                it = c_.upper_bound(key);
+            }
+            else {
+                it = upper_bound_from(it, key);
+            }
+
+            if (it == c_.cbegin()) {
+                if (!has_first_val_)  throw std::out_of_range("interval_map::at_many");
+                *out = first_val_;
+            }
+            else {
+                *out = std::prev(it)->second;
+            }
+            ++out;
+        }
+
+        return out;
+    }
+
+    /**
+     * Looks up a sequence of keys in any order, writing the value mapped to each of them to `out`.
+     *
+     * On random access containers, the keys are searched in groups of `lookup_group_size`
+     * interleaved binary searches: each step of a search prefetches the key it compares next,
+     * and the steps of the other searches of the group run while it is loaded, so the cache
+     * misses of the group overlap instead of following each other. The searches of a map of n
+     * pairs all take the same number of steps, so the group advances in lockstep. Node-based
+     * containers do not expose their nodes, and search each key from the root.
+     *
+     * @param first iterator to the first key
+     * @param last iterator past the last key
+     * @param out output iterator receiving the mapped values
+     * @return the output iterator past the last value written
+     */
+    template<class ForwardIt, class OutputIt>
+    OutputIt at_many_unsorted(ForwardIt first, ForwardIt last, OutputIt out) const
+    {
+        using category = typename std::iterator_traits<const_iterator>::iterator_category;
+
+        if constexpr (std::is_base_of_v<std::random_access_iterator_tag, category>) {
+            const const_iterator elements = c_.cbegin();
+            ForwardIt keys[lookup_group_size];
+            size_type positions[lookup_group_size];
+
+            while (first != last) {
+                size_type m = 0;
+                for (; m < lookup_group_size && first != last; ++first, ++m) {
+                    keys[m] = first;
+                    positions[m] = 0;
+                }
+
+                // Each search keeps the first element of a range of `len` elements holding its
+                // upper bound, or the end of the map if it is the last one
+                size_type len = c_.size();
+                while (len > 1) {
+                    const size_type half = len / 2;
+                    for (size_type j = 0; j < m; j++) {
+                        if (!key_comp_(*keys[j], elements[positions[j] + half].first))  positions[j] += half;
+#if defined(__GNUC__)
+                        __builtin_prefetch(&elements[positions[j] + (len - half) / 2].first);
+#endif
+                    }
+                    len -= half;
+                }
+
+                for (size_type j = 0; j < m; j++, ++out) {
+                    if (len == 1 && !key_comp_(*keys[j], elements[positions[j]].first)) {
+                        *out = elements[positions[j]].second;
+                    }
+                    else if (positions[j] > 0) {
+                        *out = elements[positions[j] - 1].second;
+                    }
+                    else {
+                        if (!has_first_val_)  throw std::out_of_range("interval_map::at_many_unsorted");
+                        *out = first_val_;
+                    }
+                }
+            }
+            return out;
+        }
+        else {
+            for (; first != last; ++first, ++out)  *out = at(*first);
+            return out;
+        }
+    }
+
+    /**
+     * Calls `f(segment_begin, segment_end, val)` on every interval overlapping
+     * [`key_begin`, `key_end`), in key order, with the interval clipped to the query bounds.
+     *
+     * The keys and values are passed by reference to the map's elements (or to the bounds), so
+     * nothing is copied. The keys before the first pair of a map without a first value map to
+     * nothing, and are skipped.
+     *
+     * @param key_begin the first key (included) of the query
+     * @param key_end the last key (excluded) of the query
+     * @param f callable taking const references to the first key (included) and last key
+     *          (excluded) of an interval, and to its value
+     */
+    template<class F>
+    void for_each_segment(const key_type& key_begin, const key_type& key_end, F&& f) const
+    {
+        if (!key_comp_(key_begin, key_end))  return;
+
+        const_iterator it = c_.upper_bound(key_begin);
+        const key_type* segment_begin = &key_begin;
+        const mapped_type* val;
+
+        if (it != c_.cbegin()) {
+            val = &std::prev(it)->second;
+        }
+        else if (has_first_val_) {
+            val = &first_val_;
+        }
+        else {
+            if (it == c_.cend() || !key_comp_(it->first, key_end))  return;
+            segment_begin = &it->first;
+            val = &it->second;
+            it++;
+        }
+
+        for (; it != c_.cend() && key_comp_(it->first, key_end); it++) {
+            f(*segment_begin, it->first, *val);
+            segment_begin = &it->first;
+            val = &it->second;
+        }
+
+        f(*segment_begin, key_end, *val);
+    }
+
     void swap(interval_map& rhs)
     {
         std::swap(first_val_, rhs.first_val_);
@@ -366,8 +808,508 @@ public:
         const interval_map<Key, T, Compare, Allocator, Container>& lhs,
         const interval_map<Key, T, Compare, Allocator, Container>& rhs
         );
+
+private:
+    /**
+     * Interval of a batch, pointing into the batch itself.
+     */
+    struct run
+    {
+        const key_type* key_begin;
+        const key_type* key_end;
+        const mapped_type* val;
+    };
+
+    bool key_comp_(const key_type& lhs, const key_type& rhs) const { return c_.key_comp()(lhs, rhs); }
+
+    /**
+     * Assigns `val` to the interval [`key_begin`, `key_end`).
+     *
+     * @param upper_bound callable returning an iterator to the first element whose key is
+     *                    greater than the key passed
+     * @return an iterator to the first element not before `key_end`
+     */
+    template<class UpperBound>
+    iterator insert_range(const key_type& key_begin, const key_type& key_end, const mapped_type& val, UpperBound&& upper_bound)
+    {
+        INTERVAL_MAP_COUNT_SCOPE(insert_ranges);
+
+        // If the interval is empty, do nothing
+        if (key_begin >= key_end)  return c_.begin();
+
+        // If the map is empty and value is equal to first_val_, do nothing
+        if (c_.empty() && has_first_val_ && equal_values(val, first_val_))  return c_.begin();
+
+        // Find the position of the upper bound of key_end
+        iterator jt = upper_bound(key_end);
+
+        // Get the value to which key_end is mapped before the insertion
+        mapped_type prev_val = (jt == c_.begin() ? first_val_ : std::prev(jt)->second);
+        INTERVAL_MAP_COUNT(value_copies, 1);
+
+        // Cannot assign the range if a previous element does not exist
+        if (jt == c_.begin() && !has_first_val_) {
+            throw std::out_of_range("interval_map::get_first_val");
+        }
+
+        // Insert the value of key_end (emplace_hint is faster than insert_or_assign)
+        jt = emplace_before(jt, key_end, prev_val);
+        // Make sure the value is assigned if the key already exists
+        jt->second = prev_val;
+        INTERVAL_MAP_COUNT(value_copies, 1);
+
+        // Insert the value of key_begin (emplace_hint is faster than insert_or_assign)
+        iterator it = emplace_before(jt, key_begin, val);
+        // Make sure the value is assigned if the key already exists
+        it->second = val;
+        INTERVAL_MAP_COUNT(value_copies, 1);
+
+        // Get the value of the element that comes before key_begin
+        prev_val = (it == c_.begin() ? first_val_ : std::prev(it)->second);
+        INTERVAL_MAP_COUNT(value_copies, 1);
+
+        // Erase all the previous values in the range (including key_begin
+        // if its value is equal to the value of its previous element)
+        if ((it == c_.begin() && !has_first_val_) || !equal_values(val, prev_val))  it++;
+        else  INTERVAL_MAP_COUNT(segments_coalesced, 1);
+        jt = erase_span(it, jt);
+
+        // If the current element is the beginning and there isn't a first value, no need to run
+        // the following lines.
+        if (jt == c_.begin() && !has_first_val_)  return jt;
+
+        // Get the value of the element before the erased range
+        prev_val = (jt == c_.begin() ? first_val_ : std::prev(jt)->second);
+        INTERVAL_MAP_COUNT(value_copies, 1);
+
+        // If the value after the erased range is equal to the value before the
+        // erased range, erase it
+        if (equal_values(jt->second, prev_val)) {
+            jt = erase_coalesced(jt);
+        }
+
+        return jt;
+    }
+
+
+    /**
+     * Finds the first element whose key is greater than `key`, searching from `pos` in either
+     * direction.
+     *
+     * @param pos iterator from which the search starts
+     * @param key the key to search
+     * @return an iterator to the first element whose key is greater than `key`
+     */
+    iterator finger_upper_bound(iterator pos, const key_type& key)
+    {
+        using category = typename std::iterator_traits<iterator>::iterator_category;
+
+        if (pos == c_.begin() || !key_comp_(key, std::prev(pos)->first)) {
+            // Convert back to a mutable iterator
+            const_iterator it = upper_bound_from(pos, key);
+            return c_.erase(it, it);
+        }
+
+        if constexpr (std::is_base_of_v<std::random_access_iterator_tag, category>) {
+            // Gallop backward until an element is not greater than key
+            const difference_type n = pos - c_.begin();
+            difference_type hi = 0;
+            difference_type step = 1;
+
+            while (step <= n && key_comp_(key, pos[-step].first)) {
+                hi = step;
+                step *= 2;
+            }
+
+            return std::upper_bound(pos - std::min(step, n), pos - hi, key, [this](const key_type& k, const auto& element) {
+                return key_comp_(k, element.first);
+            });
+        }
+        else {
+            for (int i = 0; i < 8; i++) {
+                pos--;
+                if (pos == c_.begin() || !key_comp_(key, std::prev(pos)->first))  return pos;
+            }
+            return c_.upper_bound(key);
+        }
+    }
+
+    /**
+     * Looks up `key` from the finger `pos`, which is moved to the first element whose key is
+     * greater than `key`.
+     */
+    const mapped_type& at(iterator& pos, const key_type& key)
+    {
+        INTERVAL_MAP_COUNT_SCOPE(lookups);
+
+        pos = finger_upper_bound(pos, key);
+
+        if (pos == c_.begin()) {
+            if (!has_first_val_)  throw std::out_of_range("interval_map::at");
+            return first_val_;
+        }
+        else {
+            return std::prev(pos)->second;
+        }
+    }
+
+    /**
+     * Finds the first element whose key is greater than `key`, searching forward from `pos`.
+     *
+     * All the keys before `pos` must not be greater than `key`. Random access containers are
+     * searched by galloping (doubling the step until `key` is passed, then binary searching the
+     * last step), node-based ones are walked for a few elements before searching from the root.
+     *
+     * @param pos iterator from which the search starts
+     * @param key the key to search
+     * @return an iterator to the first element whose key is greater than `key`
+     */
+    const_iterator upper_bound_from(const_iterator pos, const key_type& key) const
+    {
+        using category = typename std::iterator_traits<const_iterator>::iterator_category;
+
+        if constexpr (std::is_base_of_v<std::random_access_iterator_tag, category>) {
+            const difference_type n = c_.cend() - pos;
+            difference_type lo = 0;
+            difference_type step = 1;
+
+            while (step <= n && !key_comp_(key, pos[step - 1].first)) {
+                lo = step;
+                step *= 2;
+            }
+
+            return std::upper_bound(pos + lo, pos + std::min(step, n), key, [this](const key_type& k, const auto& element) {
+                return key_comp_(k, element.first);
+            });
+        }
+        else {
+            for (int i = 0; i < 8; i++, pos++) {
+                if (pos == c_.cend() || key_comp_(key, pos->first))  return pos;
+            }
+            return c_.upper_bound(key);
+        }
+    }
+
+    /**
+     * Checks that calling `insert_range` on a batch of intervals in order would find a previous
+     * element for each of them, throwing otherwise before the map is modified.
+     *
+     * On a map without first value, each interval must end at or after the first key of the
+     * map, which moves to the first key of every interval starting before it.
+     *
+     * @param first iterator to the first interval, a tuple-like (key_begin, key_end, val)
+     * @param last iterator past the last interval
+     */
+    template<class ForwardIt>
+    void check_previous_elements(ForwardIt first, ForwardIt last) const
+    {
+        if (has_first_val_)  return;
+
+        const key_type* first_key = (c_.empty() ? nullptr : &c_.begin()->first);
+        for (; first != last; ++first) {
+            const auto& op = *first;
+            if (!key_comp_(std::get<0>(op), std::get<1>(op)))  continue;
+
+            if (first_key == nullptr || key_comp_(std::get<1>(op), *first_key)) {
+                throw std::out_of_range("interval_map::get_first_val");
+            }
+            if (key_comp_(std::get<0>(op), *first_key))  first_key = &std::get<0>(op);
+        }
+    }
+
+    /**
+     * Resolves the overlaps of a batch of intervals, giving priority to the last ones.
+     *
+     * The keys are swept in order, keeping the intervals covering the current key in a heap
+     * ordered by their position in the batch. Adjacent pieces with the same value are joined.
+     *
+     * @param first iterator to the first interval, a tuple-like (key_begin, key_end, val)
+     * @param last iterator past the last interval
+     * @return the disjoint intervals sorted by key
+     */
+    template<class ForwardIt>
+    std::vector<run> resolve_runs(ForwardIt first, ForwardIt last) const
+    {
+        std::vector<run> ops;
+        for (; first != last; ++first) {
+            const auto& op = *first;
+            if (!key_comp_(std::get<0>(op), std::get<1>(op)))  continue;
+            ops.push_back({ &std::get<0>(op), &std::get<1>(op), &std::get<2>(op) });
+        }
+
+        return sweep_runs(ops);
+    }
+
+    /**
+     * Resolves the overlaps of intervals, giving priority to the last ones.
+     *
+     * @param ops the intervals, in batch order
+     * @return the disjoint intervals sorted by key
+     */
+    std::vector<run> sweep_runs(const std::vector<run>& ops) const
+    {
+        std::vector<const key_type*> keys;
+        keys.reserve(2 * ops.size());
+        for (const run& op : ops) {
+            keys.push_back(op.key_begin);
+            keys.push_back(op.key_end);
+        }
+
+        auto less = [this](const key_type* a, const key_type* b) { return key_comp_(*a, *b); };
+        std::sort(keys.begin(), keys.end(), less);
+        keys.erase(std::unique(keys.begin(), keys.end(), [&less](const key_type* a, const key_type* b) {
+            return !less(a, b) && !less(b, a);
+        }), keys.end());
+
+        // Order the intervals by key_begin, keeping the batch position to break overlaps
+        std::vector<std::size_t> order(ops.size());
+        for (std::size_t i = 0; i < order.size(); i++)  order[i] = i;
+        std::stable_sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+            return less(ops[a].key_begin, ops[b].key_begin);
+        });
+
+        std::priority_queue<std::size_t> active;
+        std::vector<run> runs;
+        std::size_t next = 0;
+
+        for (std::size_t i = 0; i + 1 < keys.size(); i++) {
+            const key_type& key = *keys[i];
+
+            while (next < order.size() && !key_comp_(key, *ops[order[next]].key_begin)) {
+                active.push(order[next++]);
+            }
+            // Intervals ending before the current key are only discarded when they are on top
+            while (!active.empty() && !key_comp_(key, *ops[active.top()].key_end))  active.pop();
+
+            if (active.empty())  continue;
+
+            const mapped_type* val = ops[active.top()].val;
+            if (!runs.empty() && runs.back().key_end == keys[i] && *runs.back().val == *val) {
+                runs.back().key_end = keys[i + 1];
+            }
+            else {
+                runs.push_back({ keys[i], keys[i + 1], val });
+            }
+        }
+
+        return runs;
+    }
+
+    /**
+     * Merges sorted disjoint intervals into the map, in a single pass over both.
+     *
+     * The result is built in a new container, so the map is left untouched if an exception is
+     * thrown.
+     *
+     * @param runs the intervals, sorted by key
+     */
+    void merge_runs(const std::vector<run>& runs)
+    {
+        Container out = empty_container();
+        merge_runs(out, runs, c_.cbegin(), c_.cend(), has_first_val_ ? &first_val_ : nullptr, nullptr);
+        c_.swap(out);
+    }
+
+    /**
+     * Merges sorted disjoint intervals into the pairs in [`it`, `last`), appending the result
+     * to the empty container `out`.
+     *
+     * @param out container receiving the pairs
+     * @param runs the intervals, sorted by key, all before `key_last`
+     * @param it iterator to the first pair
+     * @param last iterator past the last pair
+     * @param prev_val value to which keys before `it` map, nullptr if there is none
+     * @param key_last key at which no value is restored after an interval, nullptr if there is none
+     */
+    void merge_runs(Container& out, const std::vector<run>& runs, const_iterator it, const_iterator last,
+        const mapped_type* prev_val, const key_type* key_last) const
+    {
+        // Appends a pair, unless its value is the same as the one of the last pair
+        auto append = [&out, first_val = prev_val](const key_type& key, const mapped_type& val) {
+            if (out.empty() ? (first_val != nullptr && *first_val == val) : std::prev(out.end())->second == val)  return;
+            out.emplace_hint(out.end(), key, val);
+        };
+
+        for (auto rt = runs.begin(); rt != runs.end(); rt++) {
+            for (; it != last && key_comp_(it->first, *rt->key_begin); it++) {
+                append(it->first, it->second);
+                prev_val = &it->second;
+            }
+
+            append(*rt->key_begin, *rt->val);
+
+            for (; it != last && key_comp_(it->first, *rt->key_end); it++)  prev_val = &it->second;
+
+            // The previous value is restored at key_end, unless another interval starts there,
+            // the map already has a pair with such key, or the key is left to the caller
+            if (std::next(rt) != runs.end() && std::next(rt)->key_begin == rt->key_end)  continue;
+            if (it != last && !key_comp_(*rt->key_end, it->first))  continue;
+            if (key_last != nullptr && !key_comp_(*rt->key_end, *key_last))  continue;
+            if (prev_val == nullptr)  throw std::out_of_range("interval_map::get_first_val");
+            append(*rt->key_end, *prev_val);
+        }
+
+        for (; it != last; it++)  append(it->first, it->second);
+    }
+
+    /**
+     * Picks up to `n_parts - 1` distinct keys splitting a batch of intervals into partitions of
+     * similar sizes, from a sample of their first keys.
+     */
+    template<class ForwardIt>
+    std::vector<key_type> sample_splitters(ForwardIt first, std::size_t n, std::size_t n_parts) const
+    {
+        const std::size_t n_samples = std::min(n, 64 * n_parts);
+        std::vector<key_type> samples;
+        samples.reserve(n_samples);
+
+        ForwardIt it = first;
+        std::size_t pos = 0;
+        for (std::size_t i = 0; i < n_samples; i++) {
+            const std::size_t next_pos = n * i / n_samples;
+            std::advance(it, static_cast<difference_type>(next_pos - pos));
+            pos = next_pos;
+            samples.push_back(std::get<0>(*it));
+        }
+        std::sort(samples.begin(), samples.end(), c_.key_comp());
+
+        std::vector<key_type> splitters;
+        for (std::size_t j = 1; j < n_parts; j++) {
+            const key_type& key = samples[n_samples * j / n_parts];
+            if (splitters.empty() || key_comp_(splitters.back(), key))  splitters.push_back(key);
+        }
+        return splitters;
+    }
+
+    /**
+     * Calls `f(i)` for each i in [0, `n`), each on its own thread, and rethrows the first
+     * exception thrown by a call once all of them have returned.
+     */
+    template<class F>
+    static void run_parallel(std::size_t n, F&& f)
+    {
+        std::vector<std::exception_ptr> errors(n);
+        std::vector<std::thread> threads;
+        threads.reserve(n);
+
+        auto work = [&f, &errors](std::size_t i) {
+            try {
+                f(i);
+            }
+            catch (...) {
+                errors[i] = std::current_exception();
+            }
+        };
+
+        try {
+            for (std::size_t i = 1; i < n; i++)  threads.emplace_back(work, i);
+        }
+        catch (...) {
+            for (std::thread& thread : threads)  thread.join();
+            throw;
+        }
+
+        work(0);
+        for (std::thread& thread : threads)  thread.join();
+
+        for (const std::exception_ptr& error : errors) {
+            if (error)  std::rethrow_exception(error);
+        }
+    }
+
+    /**
+     * Returns an empty container with the comparator and, if it can be passed, the allocator of
+     * the map's container.
+     */
+    Container empty_container() const
+    {
+        if constexpr (std::is_constructible_v<Container, const key_compare&, const allocator_type&>) {
+            return Container(c_.key_comp(), c_.get_allocator());
+        }
+        else {
+            return Container(c_.key_comp());
+        }
+    }
+
+    /**
+     * Emplaces (`key`, `val`) before `pos`, keeping `pos` valid.
+     *
+     * Node-based containers do not invalidate iterators on insertion, whereas contiguous ones
+     * shift `pos` by one element when a new element is inserted before it.
+     *
+     * @param pos iterator to the element before which the pair is inserted, updated on return
+     * @param key the key of the element
+     * @param val the value of the element
+     * @return an iterator to the inserted element, or to the element with the same key
+     */
+    iterator emplace_before(iterator& pos, const key_type& key, const mapped_type& val)
+    {
+        using category = typename std::iterator_traits<iterator>::iterator_category;
+
+        [[maybe_unused]] const size_type size = c_.size();
+        iterator it;
+
+        if constexpr (std::is_base_of_v<std::random_access_iterator_tag, category>) {
+            const difference_type offset = pos - c_.begin();
+            it = c_.emplace_hint(pos, key, val);
+            pos = c_.begin() + (offset + static_cast<difference_type>(c_.size() - size));
+        }
+        else {
+            it = c_.emplace_hint(pos, key, val);
+        }
+
+        INTERVAL_MAP_COUNT(nodes_allocated, c_.size() - size);
+        INTERVAL_MAP_COUNT(value_copies, c_.size() - size);
+        return it;
+    }
+
+    bool equal_values(const mapped_type& a, const mapped_type& b) const
+    {
+        INTERVAL_MAP_COUNT(value_compares, 1);
+        return a == b;
+    }
+
+    /**
+     * Erases a pair whose value is equal to the value of the previous pair.
+     */
+    iterator erase_coalesced(iterator pos)
+    {
+        INTERVAL_MAP_COUNT(segments_coalesced, 1);
+        INTERVAL_MAP_COUNT(nodes_erased, 1);
+        return c_.erase(pos);
+    }
+
+    /**
+     * Erases the pairs in [`first`, `last`).
+     */
+    iterator erase_span(iterator first, iterator last)
+    {
+#ifdef INTERVAL_MAP_STATS
+        const std::uint64_t n = static_cast<std::uint64_t>(std::distance(first, last));
+        stats_.erase_spans++;
+        stats_.erase_span_total += n;
+        stats_.erase_span_max.update_max(n);
+        stats_.nodes_erased += n;
+#endif
+        return c_.erase(first, last);
+    }
 };
 
+/**
+ * Interval map storing its intervals in sorted contiguous key and value arrays.
+ *
+ * Lookups are faster and memory usage is lower than with the default node-based container,
+ * but modifying the map costs linear time in the number of intervals after the position.
+ */
+template<class Key, class T, class Compare = std::less<Key>>
+using flat_interval_map = interval_map<
+    Key,
+    T,
+    Compare,
+    std::allocator<std::pair<const Key, T>>,
+    flat_map<Key, T, Compare>
+>;
+
 namespace std {
     template<class Key, class T, class Compare, class Allocator, class Container>
     void swap(
@@ -455,10 +1397,94 @@ bool operator>=(
     return lhs.c_ <= rhs.c_;
 }
 
+/**
+ * Combines two interval maps key by key.
+ *
+ * Walks the intervals of both maps in lockstep, so it takes linear time in the total number of
+ * intervals, and appends the combined values to the result, skipping the ones equal to the
+ * previous value. A map without a first value maps no value to the keys before its first pair:
+ * these keys map to nothing in the result either, which only has a first value if both maps
+ * have one.
+ *
+ * @param lhs the first map, whose comparator and allocator are used by the result
+ * @param rhs the second map
+ * @param combine callable returning the value of a key given its values in `lhs` and `rhs`;
+ *                it also combines the first values of the maps into the result's first value
+ * @return the combined map
+ */
+template<class Key, class T, class Compare, class Allocator, class Container, class Combine>
+interval_map<Key, T, Compare, Allocator, Container> merge(
+    const interval_map<Key, T, Compare, Allocator, Container>& lhs,
+    const interval_map<Key, T, Compare, Allocator, Container>& rhs,
+    Combine combine
+    )
+{
+    using allocator_type = typename Container::allocator_type;
+
+    const Compare comp = lhs.key_comp();
+    const T* lhs_val = (lhs.has_first_val() ? &lhs.get_first_val() : nullptr);
+    const T* rhs_val = (rhs.has_first_val() ? &rhs.get_first_val() : nullptr);
+
+    std::optional<T> first_val;
+    if (lhs_val != nullptr && rhs_val != nullptr)  first_val = combine(*lhs_val, *rhs_val);
+
+    Container c = [&lhs, &comp]() {
+        if constexpr (std::is_constructible_v<Container, const Compare&, const allocator_type&>) {
+            return Container(comp, lhs.get_allocator());
+        }
+        else {
+            return Container(comp);
+        }
+    }();
+
+    auto lt = lhs.begin();
+    auto rt = rhs.begin();
+
+    while (lt != lhs.end() || rt != rhs.end()) {
+        const Key* key;
+
+        if (rt == rhs.end() || (lt != lhs.end() && comp(lt->first, rt->first))) {
+            key = &lt->first;
+            lhs_val = &lt->second;
+            lt++;
+        }
+        else if (lt == lhs.end() || comp(rt->first, lt->first)) {
+            key = &rt->first;
+            rhs_val = &rt->second;
+            rt++;
+        }
+        else {
+            key = &lt->first;
+            lhs_val = &lt->second;
+            rhs_val = &rt->second;
+            lt++;
+            rt++;
+        }
+
+        // Keys mapped by only one of the maps map to nothing
+        if (lhs_val == nullptr || rhs_val == nullptr)  continue;
+
+        T val = combine(*lhs_val, *rhs_val);
+        const T* prev_val = (c.empty() ? (first_val ? &*first_val : nullptr) : &std::prev(c.end())->second);
+        if (prev_val == nullptr || !(val == *prev_val)) {
+            c.emplace_hint(c.end(), *key, std::move(val));
+        }
+    }
+
+    if (first_val)  return interval_map<Key, T, Compare, Allocator, Container>(*first_val, std::move(c));
+
+    interval_map<Key, T, Compare, Allocator, Container> result(T(), std::move(c));
+    result.reset_first_val();
+    return result;
+}
+
 template <class Container>
 interval_map(Container) -> interval_map<typename Container::key_type, typename Container::mapped_type>;
 
 template <class Container, class Allocator>
 interval_map(Container, Allocator) -> interval_map<typename Container::key_type, typename Container::mapped_type>;
 
+#undef INTERVAL_MAP_COUNT
+#undef INTERVAL_MAP_COUNT_SCOPE
+
 #endif
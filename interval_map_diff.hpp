@@ -0,0 +1,159 @@
+#ifndef _INTERVAL_MAP_DIFF_HPP
+#define _INTERVAL_MAP_DIFF_HPP
+
+#include <optional>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "interval_map.hpp"
+
+/**
+ * Changes turning an interval map into another one, computed by diff and applied by apply_diff.
+ *
+ * @tparam Key The type of the key
+ * @tparam T The type of the values
+ */
+template<class Key, class T>
+struct interval_map_diff
+{
+    /**
+     * True if the first value is unset, before the other changes.
+     */
+    bool reset_first_val{ false };
+
+    /**
+     * First value to be set, if it changes.
+     */
+    std::optional<T> first_val{};
+
+    /**
+     * Disjoint intervals to be assigned, sorted by key, in the format of `insert_ranges`.
+     */
+    std::vector<std::tuple<Key, Key, T>> ranges{};
+
+    /**
+     * Key from which all the following keys map to a new value, applied with `insert` as no
+     * interval can end after them.
+     */
+    std::optional<std::pair<Key, T>> last{};
+
+    bool empty() const noexcept { return !reset_first_val && !first_val && ranges.empty() && !last; }
+};
+
+/**
+ * Computes the changes turning `old_map` into `new_map`, walking both maps once.
+ *
+ * The keys are visited in order at the pairs of both maps. Each segment of `new_map` where the
+ * maps differ gives a single interval, from the first to the last key where they differ, which
+ * is the fewest disjoint intervals possible. Comparing maps of n and m pairs takes O(n + m).
+ *
+ * @param old_map the map to which the changes apply
+ * @param new_map the map resulting from the changes
+ * @return the changes
+ * @throws std::invalid_argument if `new_map` has no first value, and its first key is not the
+ *         first key of `old_map`, as no change can unmap keys
+ */
+template<class Key, class T, class Compare, class Allocator, class Container>
+interval_map_diff<Key, T> diff(
+    const interval_map<Key, T, Compare, Allocator, Container>& old_map,
+    const interval_map<Key, T, Compare, Allocator, Container>& new_map
+)
+{
+    const auto comp = new_map.key_comp();
+    interval_map_diff<Key, T> result;
+
+    // Keys before the first pair map to the first value of new_map once it is set
+    const T* old_val = nullptr;
+    if (new_map.has_first_val()) {
+        if (!old_map.has_first_val() || !(old_map.get_first_val() == new_map.get_first_val())) {
+            result.first_val = new_map.get_first_val();
+        }
+        old_val = &new_map.get_first_val();
+    }
+    else {
+        const bool same_start = (old_map.size() == 0 || new_map.size() == 0) ?
+            old_map.size() == new_map.size() :
+            !comp(old_map.begin()->first, new_map.begin()->first) && !comp(new_map.begin()->first, old_map.begin()->first);
+        if (!same_start)  throw std::invalid_argument("diff");
+        result.reset_first_val = old_map.has_first_val();
+    }
+    const T* new_val = old_val;
+
+    auto it = old_map.begin();
+    auto jt = new_map.begin();
+    const Key* key = nullptr;
+
+    // Interval being built in the current segment of new_map: its first key, its value, and its
+    // end once the maps agree again
+    const Key* key_begin = nullptr;
+    const Key* key_end = nullptr;
+    const T* val = nullptr;
+
+    while (it != old_map.end() || jt != new_map.end()) {
+        bool new_segment = false;
+
+        if (jt == new_map.end() || (it != old_map.end() && comp(it->first, jt->first))) {
+            key = &it->first;
+            old_val = &it->second;
+            ++it;
+        }
+        else {
+            key = &jt->first;
+            if (it != old_map.end() && !comp(jt->first, it->first)) {
+                old_val = &it->second;
+                ++it;
+            }
+            new_val = &jt->second;
+            new_segment = true;
+            ++jt;
+        }
+
+        if (new_segment && key_begin != nullptr) {
+            result.ranges.emplace_back(*key_begin, key_end != nullptr ? *key_end : *key, *val);
+            key_begin = nullptr;
+        }
+
+        if (!(*old_val == *new_val)) {
+            if (key_begin == nullptr) {
+                key_begin = key;
+                val = new_val;
+            }
+            key_end = nullptr;
+        }
+        else if (key_begin != nullptr && key_end == nullptr) {
+            key_end = key;
+        }
+    }
+
+    if (key_begin != nullptr) {
+        if (key_end != nullptr) {
+            result.ranges.emplace_back(*key_begin, *key_end, *val);
+        }
+        else {
+            // The maps differ up to the end, after the last pair of both
+            if (comp(*key_begin, *key))  result.ranges.emplace_back(*key_begin, *key, *val);
+            result.last.emplace(*key, *val);
+        }
+    }
+
+    return result;
+}
+
+/**
+ * Applies changes computed by diff to a map equal to the old map, making it equal to the new one.
+ *
+ * @param imap the map to be changed
+ * @param changes the changes
+ */
+template<class Key, class T, class Compare, class Allocator, class Container>
+void apply_diff(interval_map<Key, T, Compare, Allocator, Container>& imap, const interval_map_diff<Key, T>& changes)
+{
+    if (changes.reset_first_val)  imap.reset_first_val();
+    if (changes.first_val)  imap.set_first_val(*changes.first_val);
+    imap.insert_ranges(changes.ranges.begin(), changes.ranges.end());
+    if (changes.last)  imap.insert(changes.last->first, changes.last->second);
+}
+
+#endif
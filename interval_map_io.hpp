@@ -0,0 +1,443 @@
+#ifndef _INTERVAL_MAP_IO_HPP
+#define _INTERVAL_MAP_IO_HPP
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <istream>
+#include <new>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// mapped_interval_map maps its file on POSIX systems, and reads it into memory elsewhere or when
+// INTERVAL_MAP_IO_NO_MMAP is defined
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(INTERVAL_MAP_IO_NO_MMAP)
+#define INTERVAL_MAP_IO_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "interval_map.hpp"
+
+/**
+ * Header of an interval map file.
+ *
+ * The file holds the header, the first value, the sorted array of the keys, and the array of the
+ * values, each section starting at a multiple of `section_alignment`. Keys and values are stored
+ * as their raw bytes, in the byte order of the machine that saved the file, so that a mapping of
+ * the file can be searched in place. Padding bytes are zero.
+ */
+struct interval_map_file_header
+{
+    static constexpr char file_magic[8] = { 'I', 'V', 'L', 'M', 'A', 'P', '\0', '\0' };
+    static constexpr std::uint32_t file_version = 1;
+    static constexpr std::uint32_t native_byte_order = 0x01020304;
+    static constexpr std::uint64_t section_alignment = 64;
+
+    /**
+     * Flags.
+     */
+    static constexpr std::uint32_t has_first_val = 1;
+    static constexpr std::uint32_t has_checksum = 2;
+
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byte_order;
+    std::uint32_t key_size;
+    std::uint32_t value_size;
+    std::uint32_t flags;
+    std::uint32_t reserved;
+    std::uint64_t count;
+    std::uint64_t keys_offset;
+    std::uint64_t values_offset;
+
+    /**
+     * 64-bit FNV-1a hash of the first value, the keys and the values, if `has_checksum` is set.
+     */
+    std::uint64_t checksum;
+
+    /**
+     * Returns a header describing `count` pairs of `Key` and `T`.
+     */
+    template<class Key, class T>
+    static interval_map_file_header make(std::uint64_t count, std::uint32_t flags)
+    {
+        interval_map_file_header header{};
+        std::memcpy(header.magic, file_magic, sizeof(file_magic));
+        header.version = file_version;
+        header.byte_order = native_byte_order;
+        header.key_size = sizeof(Key);
+        header.value_size = sizeof(T);
+        header.flags = flags;
+        header.count = count;
+        header.keys_offset = align(section_alignment + sizeof(T));
+        header.values_offset = align(header.keys_offset + count * sizeof(Key));
+        return header;
+    }
+
+    /**
+     * Returns the size in bytes of the file.
+     */
+    std::uint64_t file_size() const { return values_offset + count * value_size; }
+
+    /**
+     * Checks that the file was saved from pairs of `Key` and `T` on a machine with the same byte
+     * order, in a format this version can read.
+     *
+     * @param size size in bytes of the file, or 0 if unknown
+     */
+    template<class Key, class T>
+    void check(std::uint64_t size = 0) const
+    {
+        if (std::memcmp(magic, file_magic, sizeof(file_magic)) != 0 || version != file_version ||
+            byte_order != native_byte_order || key_size != sizeof(Key) || value_size != sizeof(T)) {
+            throw std::runtime_error("interval_map_file_header::check");
+        }
+
+        const interval_map_file_header expected = make<Key, T>(count, flags);
+        if (count > (UINT64_MAX - section_alignment * 3) / (sizeof(Key) + sizeof(T)) ||
+            keys_offset != expected.keys_offset || values_offset != expected.values_offset ||
+            (size != 0 && size < file_size())) {
+            throw std::runtime_error("interval_map_file_header::check");
+        }
+    }
+
+    /**
+     * Continues the 64-bit FNV-1a hash `h` with `n` bytes from `p`.
+     */
+    static std::uint64_t fnv1a(const void* p, std::size_t n, std::uint64_t h = 0xcbf29ce484222325)
+    {
+        const unsigned char* bytes = static_cast<const unsigned char*>(p);
+        for (std::size_t i = 0; i < n; i++)  h = (h ^ bytes[i]) * 0x100000001b3;
+        return h;
+    }
+
+    static std::uint64_t align(std::uint64_t offset)
+    {
+        return (offset + section_alignment - 1) / section_alignment * section_alignment;
+    }
+};
+
+static_assert(sizeof(interval_map_file_header) <= interval_map_file_header::section_alignment);
+static_assert(std::is_trivially_copyable_v<interval_map_file_header>);
+
+/**
+ * Saves an interval map to a stream, in the format described by interval_map_file_header.
+ *
+ * @param imap the map to be saved
+ * @param out the binary stream to which the file is written
+ * @param checksum true to store a checksum of the content
+ */
+template<class Key, class T, class Compare, class Allocator, class Container>
+void save_interval_map(
+    const interval_map<Key, T, Compare, Allocator, Container>& imap,
+    std::ostream& out,
+    bool checksum = true
+)
+{
+    static_assert(std::is_trivially_copyable_v<Key> && std::is_trivially_copyable_v<T>,
+        "save_interval_map requires trivially copyable keys and values");
+
+    const T first_val = (imap.has_first_val() ? imap.get_first_val() : T{});
+    const std::uint32_t flags = (imap.has_first_val() ? interval_map_file_header::has_first_val : 0) |
+        (checksum ? interval_map_file_header::has_checksum : 0);
+    interval_map_file_header header = interval_map_file_header::make<Key, T>(imap.size(), flags);
+
+    if (checksum) {
+        std::uint64_t h = interval_map_file_header::fnv1a(&first_val, sizeof(T));
+        for (const auto& pair : imap)  h = interval_map_file_header::fnv1a(&pair.first, sizeof(Key), h);
+        for (const auto& pair : imap)  h = interval_map_file_header::fnv1a(&pair.second, sizeof(T), h);
+        header.checksum = h;
+    }
+
+    const char padding[interval_map_file_header::section_alignment] = {};
+    std::uint64_t offset = 0;
+    auto pad_to = [&](std::uint64_t next) {
+        out.write(padding, static_cast<std::streamsize>(next - offset));
+        offset = next;
+    };
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    offset += sizeof(header);
+    pad_to(interval_map_file_header::section_alignment);
+    out.write(reinterpret_cast<const char*>(&first_val), sizeof(T));
+    offset += sizeof(T);
+
+    pad_to(header.keys_offset);
+    for (const auto& pair : imap)  out.write(reinterpret_cast<const char*>(&pair.first), sizeof(Key));
+    offset += header.count * sizeof(Key);
+
+    pad_to(header.values_offset);
+    for (const auto& pair : imap)  out.write(reinterpret_cast<const char*>(&pair.second), sizeof(T));
+
+    if (!out)  throw std::runtime_error("save_interval_map");
+}
+
+/**
+ * Loads an interval map saved by save_interval_map.
+ *
+ * The whole file is read and checked against its checksum, if it has one.
+ *
+ * @param in the binary stream from which the file is read
+ * @return the interval map
+ */
+template<
+    class Key,
+    class T,
+    class Compare = std::less<Key>,
+    class Allocator = std::allocator<std::pair<const Key, T>>,
+    class Container = std::map<Key, T, Compare, Allocator>
+>
+interval_map<Key, T, Compare, Allocator, Container> load_interval_map(std::istream& in)
+{
+    static_assert(std::is_trivially_copyable_v<Key> && std::is_trivially_copyable_v<T>,
+        "load_interval_map requires trivially copyable keys and values");
+
+    interval_map_file_header header;
+    char padding[interval_map_file_header::section_alignment];
+    auto read = [&in](void* p, std::uint64_t n) {
+        if (!in.read(static_cast<char*>(p), static_cast<std::streamsize>(n)))  throw std::runtime_error("load_interval_map");
+    };
+
+    read(&header, sizeof(header));
+    header.check<Key, T>();
+    read(padding, interval_map_file_header::section_alignment - sizeof(header));
+
+    T first_val;
+    read(&first_val, sizeof(T));
+    read(padding, header.keys_offset - interval_map_file_header::section_alignment - sizeof(T));
+
+    std::vector<Key> keys(header.count);
+    read(keys.data(), header.count * sizeof(Key));
+    read(padding, header.values_offset - header.keys_offset - header.count * sizeof(Key));
+
+    std::vector<T> values(header.count);
+    read(values.data(), header.count * sizeof(T));
+
+    if (header.flags & interval_map_file_header::has_checksum) {
+        std::uint64_t h = interval_map_file_header::fnv1a(&first_val, sizeof(T));
+        h = interval_map_file_header::fnv1a(keys.data(), keys.size() * sizeof(Key), h);
+        h = interval_map_file_header::fnv1a(values.data(), values.size() * sizeof(T), h);
+        if (h != header.checksum)  throw std::runtime_error("load_interval_map");
+    }
+
+    Container c;
+    for (std::size_t i = 0; i < keys.size(); i++)  c.emplace_hint(c.end(), keys[i], values[i]);
+
+    interval_map<Key, T, Compare, Allocator, Container> imap(first_val, std::move(c));
+    if (!(header.flags & interval_map_file_header::has_first_val))  imap.reset_first_val();
+    return imap;
+}
+
+/**
+ * Class answering lookups from a memory mapping of a file saved by save_interval_map.
+ *
+ * Opening the file only maps it and checks its header: the keys and values are never copied,
+ * and `at` searches the mapped key array in place, so the pages are loaded on demand by the
+ * operating system. The map is read-only, and the file must not be modified while it is mapped.
+ * Without mmap (on non-POSIX systems, or when `INTERVAL_MAP_IO_NO_MMAP` is defined), the file is
+ * read once into an aligned buffer instead, and searched there in the same way.
+ *
+ * @tparam Key The type of the key
+ * @tparam T The type of the values
+ * @tparam Compare Callable defining a strict weak ordering for the keys, the same as the saved map's
+ */
+template<class Key, class T, class Compare = std::less<Key>>
+class mapped_interval_map
+{
+    static_assert(std::is_trivially_copyable_v<Key> && std::is_trivially_copyable_v<T>,
+        "mapped_interval_map requires trivially copyable keys and values");
+    static_assert(alignof(Key) <= interval_map_file_header::section_alignment &&
+        alignof(T) <= interval_map_file_header::section_alignment);
+
+public:
+    using key_type = Key;
+    using mapped_type = T;
+    using key_compare = Compare;
+    using size_type = std::size_t;
+
+protected:
+    /**
+     * Mapping of the file, or buffer holding it.
+     */
+    void* data_{ nullptr };
+    std::size_t data_size_{ 0 };
+
+    const interval_map_file_header* header_{ nullptr };
+    const T* first_val_{ nullptr };
+    const Key* keys_{ nullptr };
+    const T* values_{ nullptr };
+
+    Compare comp_;
+
+public:
+    /**
+     * Constructor.
+     *
+     * @param path path of the file
+     * @param verify_checksum true to read the whole file and check it against its checksum, if
+     *                        it has one
+     * @param comp comparator used to order the keys
+     */
+    explicit mapped_interval_map(const std::string& path, bool verify_checksum = false, const Compare& comp = Compare()) :
+        comp_(comp)
+    {
+        load(path);
+
+        try {
+            const char* base = static_cast<const char*>(data_);
+            header_ = reinterpret_cast<const interval_map_file_header*>(base);
+            header_->template check<Key, T>(data_size_);
+
+            first_val_ = reinterpret_cast<const T*>(base + interval_map_file_header::section_alignment);
+            keys_ = reinterpret_cast<const Key*>(base + header_->keys_offset);
+            values_ = reinterpret_cast<const T*>(base + header_->values_offset);
+
+            if (verify_checksum && (header_->flags & interval_map_file_header::has_checksum)) {
+                std::uint64_t h = interval_map_file_header::fnv1a(first_val_, sizeof(T));
+                h = interval_map_file_header::fnv1a(keys_, size() * sizeof(Key), h);
+                h = interval_map_file_header::fnv1a(values_, size() * sizeof(T), h);
+                if (h != header_->checksum)  throw std::runtime_error("mapped_interval_map");
+            }
+        }
+        catch (...) {
+            release();
+            throw;
+        }
+    }
+
+    mapped_interval_map(mapped_interval_map&& other) noexcept :
+        data_(std::exchange(other.data_, nullptr)),
+        data_size_(other.data_size_),
+        header_(other.header_),
+        first_val_(other.first_val_),
+        keys_(other.keys_),
+        values_(other.values_),
+        comp_(other.comp_)
+    {}
+
+    mapped_interval_map& operator=(mapped_interval_map&& other) noexcept
+    {
+        std::swap(data_, other.data_);
+        std::swap(data_size_, other.data_size_);
+        std::swap(header_, other.header_);
+        std::swap(first_val_, other.first_val_);
+        std::swap(keys_, other.keys_);
+        std::swap(values_, other.values_);
+        std::swap(comp_, other.comp_);
+        return *this;
+    }
+
+    mapped_interval_map(const mapped_interval_map&) = delete;
+    mapped_interval_map& operator=(const mapped_interval_map&) = delete;
+
+    ~mapped_interval_map()
+    {
+        if (data_ != nullptr)  release();
+    }
+
+    size_type size() const noexcept { return static_cast<size_type>(header_->count); }
+
+    bool has_first_val() const noexcept { return header_->flags & interval_map_file_header::has_first_val; }
+
+    /**
+     * Returns a const reference to the first value.
+     */
+    const mapped_type& get_first_val() const
+    {
+        if (!has_first_val())  throw std::out_of_range("mapped_interval_map::get_first_val");
+        return *first_val_;
+    }
+
+    /**
+     * Returns a const reference to the value that is mapped to a key equivalent to `key`.
+     *
+     * @param key the key of the element to find
+     * @return a const reference to the mapped value, inside the mapping
+     */
+    const mapped_type& at(const key_type& key) const
+    {
+        const std::size_t i = std::upper_bound(keys_, keys_ + size(), key, comp_) - keys_;
+        if (i == 0) {
+            if (!has_first_val())  throw std::out_of_range("mapped_interval_map::at");
+            return *first_val_;
+        }
+        return values_[i - 1];
+    }
+
+private:
+    /**
+     * Maps the file, or reads it into a buffer, at data_.
+     */
+    void load(const std::string& path)
+    {
+#ifdef INTERVAL_MAP_IO_MMAP
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)  throw std::system_error(errno, std::generic_category(), "mapped_interval_map");
+
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            const int error = errno;
+            ::close(fd);
+            throw std::system_error(error, std::generic_category(), "mapped_interval_map");
+        }
+        if (static_cast<std::uint64_t>(st.st_size) < sizeof(interval_map_file_header)) {
+            ::close(fd);
+            throw std::system_error(EINVAL, std::generic_category(), "mapped_interval_map");
+        }
+
+        data_size_ = static_cast<std::size_t>(st.st_size);
+        data_ = ::mmap(nullptr, data_size_, PROT_READ, MAP_SHARED, fd, 0);
+        const int error = errno;
+        ::close(fd);
+        if (data_ == MAP_FAILED) {
+            data_ = nullptr;
+            throw std::system_error(error, std::generic_category(), "mapped_interval_map");
+        }
+#else
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        if (!in)  throw std::system_error(std::make_error_code(std::errc::no_such_file_or_directory), "mapped_interval_map");
+
+        const std::streamoff size = in.tellg();
+        if (size < static_cast<std::streamoff>(sizeof(interval_map_file_header))) {
+            throw std::system_error(std::make_error_code(std::errc::invalid_argument), "mapped_interval_map");
+        }
+
+        data_size_ = static_cast<std::size_t>(size);
+        data_ = ::operator new(data_size_, std::align_val_t(interval_map_file_header::section_alignment));
+        in.seekg(0);
+        if (!in.read(static_cast<char*>(data_), size)) {
+            release();
+            throw std::system_error(std::make_error_code(std::errc::io_error), "mapped_interval_map");
+        }
+#endif
+    }
+
+    /**
+     * Unmaps or frees data_.
+     */
+    void release() noexcept
+    {
+#ifdef INTERVAL_MAP_IO_MMAP
+        ::munmap(data_, data_size_);
+#else
+        ::operator delete(data_, std::align_val_t(interval_map_file_header::section_alignment));
+#endif
+        data_ = nullptr;
+    }
+};
+
+#undef INTERVAL_MAP_IO_MMAP
+
+#endif
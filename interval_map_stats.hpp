@@ -0,0 +1,156 @@
+#ifndef _INTERVAL_MAP_STATS_HPP
+#define _INTERVAL_MAP_STATS_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <utility>
+
+/**
+ * Counter of interval_map_stats, updated with relaxed atomic operations so that concurrent
+ * readers of a map can count their lookups. Copying a counter copies its current value.
+ */
+class stats_counter
+{
+    std::atomic<std::uint64_t> n_{ 0 };
+
+public:
+    stats_counter() noexcept {}
+
+    stats_counter(std::uint64_t n) noexcept : n_(n) {}
+
+    stats_counter(const stats_counter& other) noexcept : n_(other.load()) {}
+
+    stats_counter& operator=(const stats_counter& other) noexcept
+    {
+        n_.store(other.load(), std::memory_order_relaxed);
+        return *this;
+    }
+
+    std::uint64_t load() const noexcept { return n_.load(std::memory_order_relaxed); }
+
+    operator std::uint64_t() const noexcept { return load(); }
+
+    stats_counter& operator+=(std::uint64_t n) noexcept
+    {
+        n_.fetch_add(n, std::memory_order_relaxed);
+        return *this;
+    }
+
+    std::uint64_t operator++(int) noexcept { return n_.fetch_add(1, std::memory_order_relaxed); }
+
+    /**
+     * Raises the counter to `n` if it is smaller.
+     */
+    void update_max(std::uint64_t n) noexcept
+    {
+        std::uint64_t current = load();
+        while (current < n && !n_.compare_exchange_weak(current, n, std::memory_order_relaxed)) {}
+    }
+};
+
+/**
+ * Counters of the work done by an interval map.
+ *
+ * The counters are only updated when `INTERVAL_MAP_STATS` is defined before including
+ * interval_map.hpp, otherwise the instrumentation compiles to nothing. Key comparisons are only
+ * counted when the comparator is wrapped in counted_compare.
+ *
+ * WARNING: the macro changes the layout of interval_map, so it must be defined, or not, in every
+ * translation unit of a program alike, e.g. on the compiler command line. Mixing instrumented
+ * and plain units is an ODR violation that links silently and corrupts the maps passed between
+ * them.
+ *
+ * The counters are atomic, so const lookups from concurrent readers count themselves without
+ * racing, as concurrent_interval_map and sharded_interval_map allow. Reading the counters while
+ * the map is used gives values that may be slightly out of date with each other.
+ */
+struct interval_map_stats
+{
+    /**
+     * Calls to `insert`, `insert_range` and `at`.
+     */
+    stats_counter inserts{};
+    stats_counter insert_ranges{};
+    stats_counter lookups{};
+
+    /**
+     * Key comparisons made during the calls above, by the map and its container.
+     */
+    stats_counter key_compares{};
+
+    /**
+     * Equality checks and copies of values.
+     */
+    stats_counter value_compares{};
+    stats_counter value_copies{};
+
+    /**
+     * Pairs added to and removed from the container.
+     */
+    stats_counter nodes_allocated{};
+    stats_counter nodes_erased{};
+
+    /**
+     * Pairs removed because their value was equal to the value of the previous pair.
+     */
+    stats_counter segments_coalesced{};
+
+    /**
+     * Range erasures of `insert_range`, the pairs they removed, and the most pairs removed by one.
+     */
+    stats_counter erase_spans{};
+    stats_counter erase_span_total{};
+    stats_counter erase_span_max{};
+
+    /**
+     * Returns the number of key comparisons made by counted_compare on the calling thread.
+     */
+    static std::uint64_t& thread_key_compares() noexcept
+    {
+        thread_local std::uint64_t n = 0;
+        return n;
+    }
+
+    /**
+     * Counts an operation, and the key comparisons made by the calling thread until the end of
+     * the scope.
+     */
+    class scope
+    {
+        interval_map_stats& stats_;
+        std::uint64_t key_compares_;
+
+    public:
+        scope(interval_map_stats& stats, stats_counter& operations) :
+            stats_(stats),
+            key_compares_(thread_key_compares())
+        {
+            operations++;
+        }
+
+        scope(const scope&) = delete;
+        scope& operator=(const scope&) = delete;
+
+        ~scope() { stats_.key_compares += thread_key_compares() - key_compares_; }
+    };
+};
+
+/**
+ * Comparator counting its calls on the calling thread, for interval_map_stats.
+ *
+ * @tparam Compare The comparator to which the calls are forwarded
+ */
+template<class Compare>
+struct counted_compare
+{
+    Compare comp{};
+
+    template<class A, class B>
+    bool operator()(A&& a, B&& b) const
+    {
+        interval_map_stats::thread_key_compares()++;
+        return comp(std::forward<A>(a), std::forward<B>(b));
+    }
+};
+
+#endif
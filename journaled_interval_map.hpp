@@ -0,0 +1,435 @@
+#ifndef _JOURNALED_INTERVAL_MAP_HPP
+#define _JOURNALED_INTERVAL_MAP_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <iterator>
+#include <optional>
+#include <ostream>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "interval_map.hpp"
+
+/**
+ * Effective change of a mutation: the keys in [`key_begin`, `key_end`) now map to `val`.
+ *
+ * A missing `key_begin` stands for all the keys before `key_end`, which also sets the first
+ * value, and a missing `key_end` for all the keys from `key_begin` on.
+ *
+ * @tparam Key The type of the key
+ * @tparam T The type of the values
+ */
+template<class Key, class T>
+struct interval_map_journal_entry
+{
+    std::optional<Key> key_begin;
+    std::optional<Key> key_end;
+    T val;
+
+    bool operator==(const interval_map_journal_entry& rhs) const
+    {
+        return key_begin == rhs.key_begin && key_end == rhs.key_end && val == rhs.val;
+    }
+
+    bool operator!=(const interval_map_journal_entry& rhs) const { return !(*this == rhs); }
+};
+
+/**
+ * Applies a journal entry to an interval map, through its public mutations.
+ *
+ * @param imap the map to be changed, whose mapped type is constructible from T
+ * @param entry the entry
+ */
+template<class Map, class Key, class T>
+void apply_journal_entry(Map& imap, const interval_map_journal_entry<Key, T>& entry)
+{
+    using mapped_type = typename Map::mapped_type;
+    const mapped_type val(entry.val);
+
+    if (entry.key_begin) {
+        if (entry.key_end) {
+            imap.insert_range(*entry.key_begin, *entry.key_end, val);
+            return;
+        }
+
+        // Assign up to the last pair, which then extends the value to all the keys after it
+        if (imap.size() > 0 && imap.key_comp()(*entry.key_begin, std::prev(imap.end())->first)) {
+            const Key last_key = std::prev(imap.end())->first;
+            imap.insert_range(*entry.key_begin, last_key, val);
+            imap.insert(last_key, val);
+        }
+        else {
+            imap.insert(*entry.key_begin, val);
+        }
+        return;
+    }
+
+    // The keys from key_end on keep their value
+    std::optional<mapped_type> end_val;
+    if (entry.key_end)  end_val = imap.at(*entry.key_end);
+
+    if (imap.size() > 0 && (!entry.key_end || imap.key_comp()(imap.begin()->first, *entry.key_end))) {
+        const Key first_key = imap.begin()->first;
+        if (entry.key_end) {
+            imap.insert_range(first_key, *entry.key_end, val);
+        }
+        else {
+            const Key last_key = std::prev(imap.end())->first;
+            if (imap.key_comp()(first_key, last_key))  imap.insert_range(first_key, last_key, val);
+            imap.insert(last_key, val);
+        }
+    }
+
+    // Without pairs before key_end, the keys from key_end to the first pair map to the first
+    // value, and are assigned their value once it changes. The first pair, which set_first_val
+    // erases if it is equal to val, is restored as the end of the interval.
+    std::optional<Key> first_key;
+    if (imap.size() > 0)  first_key = imap.begin()->first;
+
+    imap.set_first_val(val);
+    if (end_val && !(*end_val == val)) {
+        if (!first_key)  imap.insert(*entry.key_end, *end_val);
+        else if (imap.key_comp()(*entry.key_end, *first_key))  imap.insert_range(*entry.key_end, *first_key, *end_val);
+    }
+}
+
+/**
+ * Applies the entries of a journal to an interval map, in order.
+ *
+ * @param imap the map to be changed, equal to the journaled map when the first entry was recorded
+ * @param entries the entries, as recorded or as compacted
+ */
+template<class Key, class T, class Compare, class Allocator, class Container>
+void replay_journal(
+    interval_map<Key, T, Compare, Allocator, Container>& imap,
+    const std::vector<interval_map_journal_entry<Key, T>>& entries
+)
+{
+    for (const auto& entry : entries)  apply_journal_entry(imap, entry);
+}
+
+/**
+ * Class implementing an interval map that records the effective change of each mutation.
+ *
+ * Each call to `insert`, `insert_range` and `set_first_val` appends to the journal the part of
+ * the keys whose value it actually changes, with the value written; mutations changing nothing
+ * are not recorded. Replaying the journal on a map equal to this one before the mutations, with
+ * replay_journal, makes it equal to this one.
+ *
+ * `compact` folds the pending entries into disjoint ones, later changes overwriting earlier
+ * ones, and `flush` returns the compacted entries and clears the journal.
+ *
+ * @tparam Key The type of the key
+ * @tparam T The type of the values
+ * @tparam Compare Callable defining a strict weak ordering for the keys
+ */
+template<class Key, class T, class Compare = std::less<Key>>
+class journaled_interval_map
+{
+public:
+    using map_type = interval_map<Key, T, Compare>;
+    using entry_type = interval_map_journal_entry<Key, T>;
+    using key_type = Key;
+    using mapped_type = T;
+    using size_type = std::size_t;
+
+protected:
+    /**
+     * Journaled map.
+     */
+    map_type map_{};
+
+    /**
+     * Entries not flushed yet.
+     */
+    std::vector<entry_type> journal_{};
+
+public:
+    /**
+     * Constructor.
+     */
+    journaled_interval_map() {}
+
+    /**
+     * Constructor.
+     *
+     * @param first_val default value to which keys map if no match is found in the map.
+     */
+    explicit journaled_interval_map(const T& first_val) :
+        map_(first_val)
+    {}
+
+    /**
+     * Returns the journaled map.
+     *
+     * @return a const reference to the map
+     */
+    const map_type& map() const noexcept { return map_; }
+
+    /**
+     * Returns the entries not flushed yet.
+     *
+     * @return a const reference to the entries
+     */
+    const std::vector<entry_type>& journal() const noexcept { return journal_; }
+
+    size_type size() const { return map_.size(); }
+
+    /**
+     * Returns a const reference to the value that is mapped to a key equivalent to `key`.
+     *
+     * @param key the key of the element to find
+     * @return a const reference to the mapped value
+     */
+    const mapped_type& at(const key_type& key) const { return map_.at(key); }
+
+    /**
+     * Sets the first value.
+     *
+     * @param val value to be assigned
+     */
+    void set_first_val(const mapped_type& val)
+    {
+        std::optional<entry_type> change = changed_part(nullptr, map_.size() > 0 ? &map_.begin()->first : nullptr, val);
+        map_.set_first_val(val);
+        if (change)  journal_.push_back(std::move(*change));
+    }
+
+    /**
+     * Manually inserts a pair to the map.
+     *
+     * @param key the key to which the value maps
+     * @param val the value to be assigned
+     */
+    void insert(const key_type& key, const mapped_type& val)
+    {
+        const auto next = map_.upper_bound(key);
+        std::optional<entry_type> change = changed_part(&key, next != map_.end() ? &next->first : nullptr, val);
+        map_.insert(key, val);
+        if (change)  journal_.push_back(std::move(*change));
+    }
+
+    /**
+     * Assigns `val` to the interval [`key_begin`, `key_end`).
+     *
+     * @param key_begin the first key (included) of the interval
+     * @param key_end the last key (excluded) of the interval
+     * @param val the value to be assigned
+     */
+    void insert_range(const key_type& key_begin, const key_type& key_end, const mapped_type& val)
+    {
+        if (!map_.key_comp()(key_begin, key_end))  return;
+
+        std::optional<entry_type> change = changed_part(&key_begin, &key_end, val);
+        map_.insert_range(key_begin, key_end, val);
+        if (change)  journal_.push_back(std::move(*change));
+    }
+
+    /**
+     * Folds the pending entries into disjoint entries with the same effect.
+     *
+     * The entries are applied to an overlay mapping each key to its new value, or to nothing if
+     * it is unchanged, and the changed segments of the overlay become the new entries. They are
+     * sorted by decreasing key, so that each entry ends where the map is already mapped when
+     * replayed on a map without first value.
+     */
+    void compact()
+    {
+        if (journal_.size() <= 1)  return;
+
+        interval_map<Key, std::optional<T>, Compare> overlay{ std::optional<T>() };
+        for (const entry_type& entry : journal_)  apply_journal_entry(overlay, entry);
+
+        std::vector<entry_type> entries;
+        const Key* key_begin = nullptr;
+        const std::optional<T>* val = &overlay.get_first_val();
+
+        for (auto it = overlay.begin(); it != overlay.end(); it++) {
+            if (*val)  entries.push_back({ key_begin ? std::optional<Key>(*key_begin) : std::nullopt, it->first, **val });
+            key_begin = &it->first;
+            val = &it->second;
+        }
+        if (*val)  entries.push_back({ key_begin ? std::optional<Key>(*key_begin) : std::nullopt, std::nullopt, **val });
+
+        journal_.assign(std::make_move_iterator(entries.rbegin()), std::make_move_iterator(entries.rend()));
+    }
+
+    /**
+     * Compacts the pending entries, and returns them.
+     *
+     * @return the entries, to be replayed in order
+     */
+    std::vector<entry_type> flush()
+    {
+        compact();
+        std::vector<entry_type> entries;
+        entries.swap(journal_);
+        return entries;
+    }
+
+private:
+    /**
+     * Returns the entry covering the keys in [`key_begin`, `key_end`) (unbounded on the sides
+     * given as nullptr) whose value is not `val`, from the first to the last of them, if any.
+     */
+    std::optional<entry_type> changed_part(const Key* key_begin, const Key* key_end, const mapped_type& val) const
+    {
+        const auto comp = map_.key_comp();
+        auto it = (key_begin ? map_.upper_bound(*key_begin) : map_.begin());
+
+        // Current segment, whose value is nullptr if its keys are not mapped
+        const Key* segment_begin = key_begin;
+        const T* segment_val = (it != map_.begin() ? &std::prev(it)->second : (map_.has_first_val() ? &map_.get_first_val() : nullptr));
+
+        bool changed = false;
+        const Key* changed_begin = nullptr;
+        const Key* changed_end = nullptr;
+
+        while (true) {
+            const bool last = (it == map_.end() || (key_end && !comp(it->first, *key_end)));
+            const Key* segment_end = (last ? key_end : &it->first);
+
+            if (segment_val == nullptr || !(*segment_val == val)) {
+                if (!changed)  changed_begin = segment_begin;
+                changed = true;
+                changed_end = segment_end;
+            }
+
+            if (last)  break;
+            segment_begin = &it->first;
+            segment_val = &it->second;
+            ++it;
+        }
+
+        if (!changed)  return std::nullopt;
+        return entry_type{
+            changed_begin ? std::optional<Key>(*changed_begin) : std::nullopt,
+            changed_end ? std::optional<Key>(*changed_end) : std::nullopt,
+            val
+        };
+    }
+};
+
+/**
+ * Writes journal entries in a compact binary format.
+ *
+ * Each entry is a byte of flags telling which keys are present, the keys, and the raw bytes of
+ * the value. Integral keys are written as variable-length integers: the first key as its
+ * zigzag-encoded difference with the previous first key, the second as its difference with the
+ * first. Other keys are written as their raw bytes.
+ *
+ * @param entries the entries
+ * @param out the binary stream to which the entries are written
+ */
+template<class Key, class T>
+void encode_journal(const std::vector<interval_map_journal_entry<Key, T>>& entries, std::ostream& out)
+{
+    static_assert(std::is_trivially_copyable_v<Key> && std::is_trivially_copyable_v<T>,
+        "encode_journal requires trivially copyable keys and values");
+
+    auto write_varint = [&out](std::uint64_t n) {
+        for (; n >= 0x80; n >>= 7)  out.put(static_cast<char>((n & 0x7f) | 0x80));
+        out.put(static_cast<char>(n));
+    };
+
+    write_varint(entries.size());
+    Key prev_key{};
+
+    for (const auto& entry : entries) {
+        out.put(static_cast<char>((entry.key_begin ? 1 : 0) | (entry.key_end ? 2 : 0)));
+
+        if constexpr (std::is_integral_v<Key>) {
+            const Key key_begin = (entry.key_begin ? *entry.key_begin : prev_key);
+            const std::uint64_t delta = static_cast<std::uint64_t>(key_begin) - static_cast<std::uint64_t>(prev_key);
+            if (entry.key_begin)  write_varint((delta << 1) ^ (0 - (delta >> 63)));
+            if (entry.key_end)  write_varint(static_cast<std::uint64_t>(*entry.key_end) - static_cast<std::uint64_t>(key_begin));
+            prev_key = key_begin;
+        }
+        else {
+            if (entry.key_begin)  out.write(reinterpret_cast<const char*>(&*entry.key_begin), sizeof(Key));
+            if (entry.key_end)  out.write(reinterpret_cast<const char*>(&*entry.key_end), sizeof(Key));
+        }
+
+        out.write(reinterpret_cast<const char*>(&entry.val), sizeof(T));
+    }
+
+    if (!out)  throw std::runtime_error("encode_journal");
+}
+
+/**
+ * Reads journal entries written by encode_journal.
+ *
+ * @param in the binary stream from which the entries are read
+ * @return the entries
+ */
+template<class Key, class T>
+std::vector<interval_map_journal_entry<Key, T>> decode_journal(std::istream& in)
+{
+    static_assert(std::is_trivially_copyable_v<Key> && std::is_trivially_copyable_v<T>,
+        "decode_journal requires trivially copyable keys and values");
+
+    auto read_varint = [&in]() {
+        std::uint64_t n = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            const int c = in.get();
+            if (c == std::istream::traits_type::eof())  throw std::runtime_error("decode_journal: truncated");
+            n |= static_cast<std::uint64_t>(c & 0x7f) << shift;
+            if ((c & 0x80) == 0)  return n;
+        }
+        throw std::runtime_error("decode_journal: invalid integer");
+    };
+
+    auto read_bytes = [&in](void* p, std::size_t size) {
+        if (!in.read(static_cast<char*>(p), static_cast<std::streamsize>(size))) {
+            throw std::runtime_error("decode_journal: truncated");
+        }
+    };
+
+    const std::uint64_t count = read_varint();
+    std::vector<interval_map_journal_entry<Key, T>> entries;
+    Key prev_key{};
+
+    for (std::uint64_t i = 0; i < count; i++) {
+        const int flags = in.get();
+        if (flags == std::istream::traits_type::eof() || (flags & ~3) != 0)  throw std::runtime_error("decode_journal: invalid entry");
+
+        std::optional<Key> key_begin;
+        std::optional<Key> key_end;
+
+        if constexpr (std::is_integral_v<Key>) {
+            Key key = prev_key;
+            if (flags & 1) {
+                const std::uint64_t zigzag = read_varint();
+                const std::uint64_t delta = (zigzag >> 1) ^ (0 - (zigzag & 1));
+                key = static_cast<Key>(static_cast<std::uint64_t>(prev_key) + delta);
+                key_begin = key;
+            }
+            if (flags & 2)  key_end = static_cast<Key>(static_cast<std::uint64_t>(key) + read_varint());
+            prev_key = key;
+        }
+        else {
+            Key key;
+            if (flags & 1) {
+                read_bytes(&key, sizeof(Key));
+                key_begin = key;
+            }
+            if (flags & 2) {
+                read_bytes(&key, sizeof(Key));
+                key_end = key;
+            }
+        }
+
+        T val;
+        read_bytes(&val, sizeof(T));
+        entries.push_back({ std::move(key_begin), std::move(key_end), val });
+    }
+
+    return entries;
+}
+
+#endif
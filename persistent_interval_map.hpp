@@ -0,0 +1,265 @@
+#ifndef _PERSISTENT_INTERVAL_MAP_HPP
+#define _PERSISTENT_INTERVAL_MAP_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <random>
+#include <utility>
+
+/**
+ * Class implementing an immutable interval map, whose modifications return new versions.
+ *
+ * The pairs are stored in a treap (a binary search tree balanced by random priorities) whose
+ * nodes are never modified once built: a modification copies the O(log n) expected nodes on the
+ * paths it changes, and shares all the other nodes with the previous version. Copying a version
+ * is therefore O(1), and nodes are freed by reference counting when no version uses them
+ * anymore. Versions can be read, copied and destroyed concurrently from several threads.
+ *
+ * @tparam Key The type of the key
+ * @tparam T The type of the values
+ * @tparam Compare Callable defining a strict weak ordering for the keys
+ */
+template<class Key, class T, class Compare = std::less<Key>>
+class persistent_interval_map
+{
+public:
+    using key_type = Key;
+    using mapped_type = T;
+    using key_compare = Compare;
+    using size_type = std::size_t;
+
+protected:
+    struct node;
+    using node_ptr = std::shared_ptr<const node>;
+
+    struct node
+    {
+        Key key;
+        T val;
+        std::uint32_t priority;
+        node_ptr left;
+        node_ptr right;
+
+        /**
+         * Number of pairs in the subtree.
+         */
+        size_type size;
+
+        node(const Key& k, const T& v, std::uint32_t p, node_ptr l, node_ptr r) :
+            key(k),
+            val(v),
+            priority(p),
+            left(std::move(l)),
+            right(std::move(r)),
+            size(1 + size_of(left) + size_of(right))
+        {}
+    };
+
+    /**
+     * First value.
+     *
+     * Keys map to this value if they come before all the pairs.
+     */
+    T first_val_;
+
+    /**
+     * Root of the treap.
+     */
+    node_ptr root_{};
+
+    /**
+     * Key comparator.
+     */
+    Compare comp_;
+
+    /**
+     * Generator of the priorities of the nodes created by the next modification.
+     */
+    std::minstd_rand rng_{};
+
+public:
+    /**
+     * Constructor.
+     *
+     * @param first_val default value to which keys map if no match is found in the map.
+     * @param comp comparator used to order the keys
+     */
+    explicit persistent_interval_map(const T& first_val, const Compare& comp = Compare()) :
+        first_val_(first_val),
+        comp_(comp)
+    {}
+
+    size_type size() const noexcept { return size_of(root_); }
+
+    bool empty() const noexcept { return root_ == nullptr; }
+
+    const mapped_type& get_first_val() const noexcept { return first_val_; }
+
+    /**
+     * Returns a const reference to the value that is mapped to a key equivalent to `key`.
+     *
+     * @param key the key of the element to find
+     * @return a const reference to the mapped value, valid as long as this version is alive
+     */
+    const mapped_type& at(const key_type& key) const
+    {
+        const T* val = &first_val_;
+        for (const node* n = root_.get(); n != nullptr;) {
+            if (comp_(key, n->key)) {
+                n = n->left.get();
+            }
+            else {
+                val = &n->val;
+                n = n->right.get();
+            }
+        }
+        return *val;
+    }
+
+    /**
+     * Calls `f(key, val)` on every pair of the map, in key order.
+     *
+     * @param f callable taking a const reference to a key and to a value
+     */
+    template<class F>
+    void for_each(F&& f) const { for_each(root_.get(), f); }
+
+    /**
+     * Returns a version where `val` is assigned to the interval [`key_begin`, `key_end`).
+     *
+     * @param key_begin the first key (included) of the interval
+     * @param key_end the last key (excluded) of the interval
+     * @param val the value to be assigned
+     * @return the new version, sharing the unmodified nodes with this one
+     */
+    persistent_interval_map insert_range(const key_type& key_begin, const key_type& key_end, const mapped_type& val) const
+    {
+        persistent_interval_map result(*this);
+        if (!comp_(key_begin, key_end))  return result;
+
+        const T& end_val = at(key_end);
+
+        node_ptr left, middle, right;
+        split(root_, key_begin, false, left, middle);
+        split(middle, key_end, false, middle, right);
+
+        const T& prev_val = (left != nullptr ? last(left.get())->val : first_val_);
+        if (!(val == prev_val)) {
+            middle = result.make_node(key_begin, val);
+        }
+        else {
+            middle.reset();
+        }
+
+        const bool has_end_pair = (right != nullptr && !comp_(key_end, first(right.get())->key));
+        if (end_val == val) {
+            // The pair at key_end, if any, repeats val
+            node_ptr dropped;
+            if (has_end_pair)  split(right, key_end, true, dropped, right);
+        }
+        else if (!has_end_pair) {
+            right = merge(result.make_node(key_end, end_val), right);
+        }
+
+        result.root_ = merge(merge(left, middle), right);
+        return result;
+    }
+
+    /**
+     * Returns a version with `val` as first value.
+     *
+     * @param val value to be assigned
+     * @return the new version, sharing all the nodes with this one
+     */
+    persistent_interval_map set_first_val(const mapped_type& val) const
+    {
+        persistent_interval_map result(*this);
+        result.first_val_ = val;
+
+        if (root_ != nullptr && first(root_.get())->val == val) {
+            node_ptr dropped;
+            split(root_, first(root_.get())->key, true, dropped, result.root_);
+        }
+        return result;
+    }
+
+private:
+    static size_type size_of(const node_ptr& n) noexcept { return (n == nullptr ? 0 : n->size); }
+
+    static const node* first(const node* n)
+    {
+        while (n->left != nullptr)  n = n->left.get();
+        return n;
+    }
+
+    static const node* last(const node* n)
+    {
+        while (n->right != nullptr)  n = n->right.get();
+        return n;
+    }
+
+    node_ptr make_node(const Key& key, const T& val)
+    {
+        return std::make_shared<const node>(key, val, static_cast<std::uint32_t>(rng_()), nullptr, nullptr);
+    }
+
+    static node_ptr with_children(const node& n, node_ptr left, node_ptr right)
+    {
+        return std::make_shared<const node>(n.key, n.val, n.priority, std::move(left), std::move(right));
+    }
+
+    /**
+     * Splits `t` into the keys less than `key` (or not greater, if `key_goes_left`) and the
+     * others, copying the nodes on the path. `t` is taken by value, so it may be one of the
+     * outputs.
+     */
+    void split(node_ptr t, const Key& key, bool key_goes_left, node_ptr& left, node_ptr& right) const
+    {
+        if (t == nullptr) {
+            left.reset();
+            right.reset();
+            return;
+        }
+
+        if (key_goes_left ? !comp_(key, t->key) : comp_(t->key, key)) {
+            node_ptr rest;
+            split(t->right, key, key_goes_left, rest, right);
+            left = with_children(*t, t->left, std::move(rest));
+        }
+        else {
+            node_ptr rest;
+            split(t->left, key, key_goes_left, left, rest);
+            right = with_children(*t, std::move(rest), t->right);
+        }
+    }
+
+    /**
+     * Joins two treaps, where all the keys of `left` are less than the keys of `right`,
+     * copying the nodes on the path.
+     */
+    static node_ptr merge(const node_ptr& left, const node_ptr& right)
+    {
+        if (left == nullptr)  return right;
+        if (right == nullptr)  return left;
+
+        if (left->priority > right->priority) {
+            return with_children(*left, left->left, merge(left->right, right));
+        }
+        else {
+            return with_children(*right, merge(left, right->left), right->right);
+        }
+    }
+
+    template<class F>
+    static void for_each(const node* n, F& f)
+    {
+        if (n == nullptr)  return;
+        for_each(n->left.get(), f);
+        f(n->key, n->val);
+        for_each(n->right.get(), f);
+    }
+};
+
+#endif
@@ -0,0 +1,229 @@
+#ifndef _POOL_ALLOCATOR_HPP
+#define _POOL_ALLOCATOR_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "interval_map.hpp"
+
+/**
+ * Class implementing a pool of small memory blocks.
+ *
+ * Blocks are carved from large chunks requested to the global allocator, and freed blocks are
+ * kept in a free list per size class to be reused by the next allocations of the same size.
+ * Chunks are only returned to the global allocator when the pool is destroyed. Requests larger
+ * than `max_block_size`, or over-aligned, are forwarded to the global allocator.
+ *
+ * The pool is not thread-safe.
+ */
+class node_pool
+{
+public:
+    /**
+     * Granularity of the size classes, which is also the alignment of the blocks.
+     */
+    static constexpr std::size_t block_alignment = alignof(std::max_align_t);
+
+    /**
+     * Size of the largest block served by the pool.
+     */
+    static constexpr std::size_t max_block_size = 256;
+
+protected:
+    struct free_block
+    {
+        free_block* next;
+    };
+
+    static constexpr std::size_t n_size_classes = max_block_size / block_alignment;
+
+    /**
+     * Heads of the free lists, one per size class.
+     */
+    free_block* free_lists_[n_size_classes]{};
+
+    /**
+     * Chunks requested to the global allocator.
+     */
+    std::vector<void*> chunks_{};
+
+    /**
+     * Size in bytes of each chunk.
+     */
+    std::size_t chunk_size_;
+
+    /**
+     * Unused part of the last chunk.
+     */
+    char* cursor_{ nullptr };
+    char* chunk_end_{ nullptr };
+
+    /**
+     * Number of requests forwarded to the global allocator.
+     */
+    std::size_t upstream_allocations_{ 0 };
+
+public:
+    /**
+     * Constructor.
+     *
+     * @param chunk_size size in bytes of the chunks requested to the global allocator
+     */
+    explicit node_pool(std::size_t chunk_size = 64 * 1024) :
+        chunk_size_(std::max(chunk_size, max_block_size))
+    {}
+
+    node_pool(const node_pool&) = delete;
+    node_pool& operator=(const node_pool&) = delete;
+
+    ~node_pool()
+    {
+        for (void* chunk : chunks_)  ::operator delete(chunk);
+    }
+
+    /**
+     * Allocates a block.
+     *
+     * @param bytes size of the block
+     * @param alignment alignment of the block
+     * @return a pointer to the block
+     */
+    void* allocate(std::size_t bytes, std::size_t alignment)
+    {
+        if (bytes > max_block_size || alignment > block_alignment) {
+            upstream_allocations_++;
+            return ::operator new(bytes);
+        }
+
+        const std::size_t size_class = size_class_of(bytes);
+
+        if (free_block* block = free_lists_[size_class]) {
+            free_lists_[size_class] = block->next;
+            return block;
+        }
+
+        const std::size_t block_size = (size_class + 1) * block_alignment;
+
+        if (static_cast<std::size_t>(chunk_end_ - cursor_) < block_size) {
+            chunks_.reserve(chunks_.size() + 1);
+            cursor_ = static_cast<char*>(::operator new(chunk_size_));
+            chunk_end_ = cursor_ + chunk_size_;
+            chunks_.push_back(cursor_);
+            upstream_allocations_++;
+        }
+
+        void* block = cursor_;
+        cursor_ += block_size;
+        return block;
+    }
+
+    /**
+     * Deallocates a block.
+     *
+     * @param p pointer to the block
+     * @param bytes size of the block, as passed to `allocate`
+     * @param alignment alignment of the block, as passed to `allocate`
+     */
+    void deallocate(void* p, std::size_t bytes, std::size_t alignment) noexcept
+    {
+        if (bytes > max_block_size || alignment > block_alignment) {
+            ::operator delete(p);
+            return;
+        }
+
+        const std::size_t size_class = size_class_of(bytes);
+        free_lists_[size_class] = ::new (p) free_block{ free_lists_[size_class] };
+    }
+
+    /**
+     * Returns the number of requests forwarded to the global allocator.
+     */
+    std::size_t upstream_allocations() const noexcept { return upstream_allocations_; }
+
+private:
+    static std::size_t size_class_of(std::size_t bytes) noexcept
+    {
+        return (std::max<std::size_t>(bytes, 1) + block_alignment - 1) / block_alignment - 1;
+    }
+};
+
+/**
+ * Allocator serving single elements from a node_pool.
+ *
+ * Node-based containers allocate one element at a time, so they reuse the blocks freed by
+ * erasures instead of going through the global allocator. Allocators rebound from each other
+ * share the same pool. Copies of a container get a new pool, so containers never share a pool
+ * unless explicitly constructed with the same one.
+ *
+ * @tparam T The type of the elements
+ */
+template<class T>
+class pool_allocator
+{
+    template<class U> friend class pool_allocator;
+
+    std::shared_ptr<node_pool> pool_;
+
+public:
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::false_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+    using is_always_equal = std::false_type;
+
+    /**
+     * Constructor.
+     *
+     * Creates a new pool.
+     */
+    pool_allocator() : pool_(std::make_shared<node_pool>()) {}
+
+    /**
+     * Constructor.
+     *
+     * @param pool the pool from which the elements are allocated
+     */
+    explicit pool_allocator(std::shared_ptr<node_pool> pool) : pool_(std::move(pool)) {}
+
+    template<class U>
+    pool_allocator(const pool_allocator<U>& other) noexcept : pool_(other.pool_) {}
+
+    T* allocate(std::size_t n)
+    {
+        if (n == 1)  return static_cast<T*>(pool_->allocate(sizeof(T), alignof(T)));
+        return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T* p, std::size_t n) noexcept
+    {
+        if (n == 1)  pool_->deallocate(p, sizeof(T), alignof(T));
+        else  std::allocator<T>().deallocate(p, n);
+    }
+
+    pool_allocator select_on_container_copy_construction() const { return pool_allocator(); }
+
+    /**
+     * Returns the pool from which the elements are allocated.
+     */
+    const std::shared_ptr<node_pool>& pool() const noexcept { return pool_; }
+
+    template<class U>
+    bool operator==(const pool_allocator<U>& rhs) const noexcept { return pool_ == rhs.pool_; }
+
+    template<class U>
+    bool operator!=(const pool_allocator<U>& rhs) const noexcept { return pool_ != rhs.pool_; }
+};
+
+/**
+ * Interval map allocating the nodes of its container from a pool.
+ */
+template<class Key, class T, class Compare = std::less<Key>>
+using pooled_interval_map = interval_map<Key, T, Compare, pool_allocator<std::pair<const Key, T>>>;
+
+#endif
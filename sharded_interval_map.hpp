@@ -0,0 +1,203 @@
+#ifndef _SHARDED_INTERVAL_MAP_HPP
+#define _SHARDED_INTERVAL_MAP_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <utility>
+#include <vector>
+
+#include "interval_map.hpp"
+
+/**
+ * Class implementing an interval map split by key into shards that can be modified in parallel.
+ *
+ * The split points divide the keys into consecutive regions, each stored in its own interval map
+ * protected by its own lock, so threads writing to different regions do not contend. Intervals
+ * crossing split points are split transparently, and the shards they touch are locked in key
+ * order for the whole assignment, so concurrent assignments behave as if applied one at a time.
+ *
+ * Each shard only answers for the keys of its region. Iterating with `for_each` joins the shards
+ * and skips the pairs that would repeat the previous value, so the pairs visited never contain
+ * consecutive equal values, including across split points.
+ *
+ * @tparam Key The type of the key
+ * @tparam T The type of the values
+ * @tparam Compare Callable defining a strict weak ordering for the keys
+ * @tparam Allocator Allocator of each element in the container
+ * @tparam Container Container used inside the class
+ */
+template<
+    class Key,
+    class T,
+    class Compare = std::less<Key>,
+    class Allocator = std::allocator<std::pair<const Key, T>>,
+    class Container = std::map<Key, T, Compare, Allocator>
+>
+class sharded_interval_map
+{
+public:
+    using map_type = interval_map<Key, T, Compare, Allocator, Container>;
+    using key_type = typename map_type::key_type;
+    using mapped_type = typename map_type::mapped_type;
+    using key_compare = Compare;
+    using size_type = typename map_type::size_type;
+
+protected:
+    /**
+     * Interval map of a region of keys, with its lock.
+     */
+    struct shard
+    {
+        mutable std::shared_mutex mutex;
+        map_type map;
+    };
+
+    /**
+     * Split points, sorted and unique.
+     *
+     * Shard i contains the keys in [splits_[i - 1], splits_[i]), the first and the last shards
+     * being unbounded below and above respectively.
+     */
+    std::vector<Key> splits_;
+
+    /**
+     * Shards, one more than the split points.
+     */
+    std::unique_ptr<shard[]> shards_;
+
+    /**
+     * Key comparator.
+     */
+    Compare comp_;
+
+public:
+    /**
+     * Constructor.
+     *
+     * @param first_val default value to which keys map if no match is found in the map.
+     * @param split_points keys at which a new shard starts
+     * @param comp comparator used to order the keys
+     */
+    sharded_interval_map(const mapped_type& first_val, std::vector<Key> split_points, const Compare& comp = Compare()) :
+        splits_(std::move(split_points)),
+        comp_(comp)
+    {
+        std::sort(splits_.begin(), splits_.end(), comp_);
+        splits_.erase(std::unique(splits_.begin(), splits_.end(), [this](const Key& a, const Key& b) {
+            return !comp_(a, b) && !comp_(b, a);
+        }), splits_.end());
+
+        shards_.reset(new shard[splits_.size() + 1]);
+        for (std::size_t i = 0; i <= splits_.size(); i++)  shards_[i].map = map_type(first_val, Container(comp_));
+    }
+
+    sharded_interval_map(const sharded_interval_map&) = delete;
+    sharded_interval_map& operator=(const sharded_interval_map&) = delete;
+
+    /**
+     * Returns the number of shards.
+     */
+    size_type shard_count() const noexcept { return splits_.size() + 1; }
+
+    /**
+     * Returns a copy of the value that is mapped to a key equivalent to `key`.
+     *
+     * @param key the key of the element to find
+     * @return the mapped value
+     */
+    mapped_type at(const key_type& key) const
+    {
+        const shard& s = shards_[shard_of(key)];
+        std::shared_lock<std::shared_mutex> lock(s.mutex);
+        return s.map.at(key);
+    }
+
+    /**
+     * Assigns `val` to the interval [`key_begin`, `key_end`).
+     *
+     * @param key_begin the first key (included) of the interval
+     * @param key_end the last key (excluded) of the interval
+     * @param val the value to be assigned
+     */
+    void insert_range(const key_type& key_begin, const key_type& key_end, const mapped_type& val)
+    {
+        if (!comp_(key_begin, key_end))  return;
+
+        const std::size_t first = shard_of(key_begin);
+        // Last shard starting before key_end
+        const std::size_t last = std::lower_bound(splits_.begin(), splits_.end(), key_end, comp_) - splits_.begin();
+
+        std::vector<std::unique_lock<std::shared_mutex>> locks;
+        locks.reserve(last - first + 1);
+        for (std::size_t i = first; i <= last; i++)  locks.emplace_back(shards_[i].mutex);
+
+        for (std::size_t i = first; i <= last; i++) {
+            const key_type& shard_begin = (i == first ? key_begin : splits_[i - 1]);
+            const key_type& shard_end = (i == last ? key_end : splits_[i]);
+            shards_[i].map.insert_range(shard_begin, shard_end, val);
+        }
+    }
+
+    /**
+     * Calls `f(key, val)` on every pair of the map, in key order.
+     *
+     * All the shards are locked for reading during the visit, which sees a consistent map.
+     *
+     * @param f callable taking a const reference to a key and to a value
+     */
+    template<class F>
+    void for_each(F&& f) const
+    {
+        std::vector<std::shared_lock<std::shared_mutex>> locks;
+        locks.reserve(shard_count());
+        for (std::size_t i = 0; i < shard_count(); i++)  locks.emplace_back(shards_[i].mutex);
+
+        const mapped_type* prev_val = &shards_[0].map.get_first_val();
+
+        for (std::size_t i = 0; i < shard_count(); i++) {
+            const map_type& map = shards_[i].map;
+            auto it = map.begin();
+
+            if (i > 0) {
+                // Value at the start of the shard, carried from the shard's own pairs
+                const mapped_type& val = map.at(splits_[i - 1]);
+                if (!(val == *prev_val)) {
+                    f(splits_[i - 1], val);
+                    prev_val = &val;
+                }
+                it = map.upper_bound(splits_[i - 1]);
+            }
+
+            for (; it != map.end() && (i == splits_.size() || comp_(it->first, splits_[i])); ++it) {
+                if (it->second == *prev_val)  continue;
+                f(it->first, it->second);
+                prev_val = &it->second;
+            }
+        }
+    }
+
+    /**
+     * Joins the shards into a single interval map.
+     *
+     * @return the interval map
+     */
+    map_type to_interval_map() const
+    {
+        Container c(comp_);
+        for_each([&c](const key_type& key, const mapped_type& val) { c.emplace_hint(c.end(), key, val); });
+
+        std::shared_lock<std::shared_mutex> lock(shards_[0].mutex);
+        return map_type(shards_[0].map.get_first_val(), std::move(c));
+    }
+
+private:
+    std::size_t shard_of(const key_type& key) const
+    {
+        return std::upper_bound(splits_.begin(), splits_.end(), key, comp_) - splits_.begin();
+    }
+};
+
+#endif
@@ -0,0 +1,304 @@
+#ifndef _SIMD_INTERVAL_MAP_HPP
+#define _SIMD_INTERVAL_MAP_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "frozen_interval_map.hpp"
+#include "interval_map.hpp"
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_INTERVAL_MAP_X86
+#include <immintrin.h>
+#endif
+
+/**
+ * Instruction sets of the lookup kernels of simd_interval_map.
+ */
+enum class simd_level
+{
+    scalar,
+    avx2,
+    avx512
+};
+
+/**
+ * Returns the best instruction set supported by the processor.
+ */
+inline simd_level detect_simd_level()
+{
+#ifdef SIMD_INTERVAL_MAP_X86
+    if (__builtin_cpu_supports("avx512f"))  return simd_level::avx512;
+    if (__builtin_cpu_supports("avx2"))  return simd_level::avx2;
+#endif
+    return simd_level::scalar;
+}
+
+/**
+ * Class implementing an immutable snapshot of an interval map of 32-bit or 64-bit integer or
+ * float keys, whose lookups compare a key with a whole node of keys per instruction.
+ *
+ * The keys are laid out as a static B-tree whose nodes are cache lines of 16 keys of 4 bytes or
+ * 8 keys of 8 bytes, each node at index k having its children at k * (B + 1) + i + 1. A lookup
+ * loads one node per level, counts the keys not greater than the searched key with one or two
+ * vector comparisons and a population count, and goes down to the child with that index: a map
+ * of 10^6 pairs takes 5 levels. The kernel (AVX-512, AVX2 or scalar) is chosen at construction
+ * from the instruction sets of the processor.
+ *
+ * @tparam Key The type of the key: std::int32_t, std::int64_t or float, ordered by std::less
+ * @tparam T The type of the values
+ */
+template<class Key, class T>
+class simd_interval_map
+{
+    static_assert(std::is_same_v<Key, std::int32_t> || std::is_same_v<Key, std::int64_t> || std::is_same_v<Key, float>,
+        "simd_interval_map requires std::int32_t, std::int64_t or float keys");
+
+public:
+    using key_type = Key;
+    using mapped_type = T;
+    using size_type = std::size_t;
+
+    /**
+     * Number of keys in a node.
+     */
+    static constexpr size_type node_size = 64 / sizeof(Key);
+
+protected:
+    /**
+     * Keys in B-tree order, the unused slots of the last nodes holding the greatest key value.
+     */
+    std::vector<Key, cache_aligned_allocator<Key>> keys_{};
+
+    /**
+     * Values, where values_[i] is the value of keys_[i].
+     */
+    std::vector<T> values_{};
+
+    size_type size_{ 0 };
+    size_type n_nodes_{ 0 };
+
+    /**
+     * Greatest key, and the slot of its value.
+     */
+    Key max_key_{};
+    size_type max_slot_{ 0 };
+
+    T first_val_{};
+    bool has_first_val_{ false };
+
+    simd_level level_;
+
+    /**
+     * Search kernel of level_, returning the slot of the greatest key not greater than `key`, or
+     * npos if there is none.
+     */
+    size_type (*find_)(const Key* keys, size_type n_nodes, Key key);
+
+    static constexpr size_type npos = static_cast<size_type>(-1);
+
+public:
+    /**
+     * Constructor.
+     *
+     * @param imap the interval map to be snapshotted
+     * @param level the instruction set of the kernel, lowered to the best one supported
+     */
+    template<class Allocator, class Container>
+    explicit simd_interval_map(
+        const interval_map<Key, T, std::less<Key>, Allocator, Container>& imap,
+        simd_level level = detect_simd_level()
+    ) :
+        size_(imap.size()),
+        n_nodes_((imap.size() + node_size - 1) / node_size),
+        has_first_val_(imap.has_first_val()),
+        level_(level < detect_simd_level() ? level : detect_simd_level())
+    {
+        if (has_first_val_)  first_val_ = imap.get_first_val();
+
+        keys_.resize(n_nodes_ * node_size);
+        values_.resize(n_nodes_ * node_size);
+        auto it = imap.begin();
+        size_type rank = 0;
+        build(it, rank, 0);
+
+        switch (level_) {
+#ifdef SIMD_INTERVAL_MAP_X86
+        case simd_level::avx512: find_ = &find_avx512; break;
+        case simd_level::avx2: find_ = &find_avx2; break;
+#endif
+        default: find_ = &find_scalar; break;
+        }
+    }
+
+    size_type size() const noexcept { return size_; }
+
+    /**
+     * Returns the instruction set of the lookup kernel.
+     */
+    simd_level level() const noexcept { return level_; }
+
+    /**
+     * Returns a const reference to the value that is mapped to a key equivalent to `key`.
+     *
+     * @param key the key of the element to find
+     * @return a const reference to the same value that the snapshotted map returns for `key`
+     */
+    const mapped_type& at(const key_type& key) const
+    {
+        // Keys from the greatest one on are answered first, so the searched keys are less than
+        // the padding
+        if (size_ > 0 && !(key < max_key_))  return values_[max_slot_];
+
+        const size_type slot = find_(keys_.data(), n_nodes_, key);
+        if (slot == npos) {
+            if (!has_first_val_)  throw std::out_of_range("simd_interval_map::at");
+            return first_val_;
+        }
+        return values_[slot];
+    }
+
+    /**
+     * Looks up a sequence of keys.
+     *
+     * @param first iterator to the first key
+     * @param last iterator past the last key
+     * @param out output iterator receiving the mapped values
+     * @return the output iterator past the last value written
+     */
+    template<class InputIt, class OutputIt>
+    OutputIt at_many(InputIt first, InputIt last, OutputIt out) const
+    {
+        for (; first != last; ++first, ++out)  *out = at(*first);
+        return out;
+    }
+
+private:
+    static size_type child(size_type k, size_type i) noexcept { return k * (node_size + 1) + i + 1; }
+
+    /**
+     * Fills the subtree rooted at node `k` in order, consuming the sorted elements from `it`.
+     */
+    template<class InputIt>
+    void build(InputIt& it, size_type& rank, size_type k)
+    {
+        if (k >= n_nodes_)  return;
+
+        for (size_type i = 0; i < node_size; i++) {
+            build(it, rank, child(k, i));
+
+            const size_type slot = k * node_size + i;
+            if (rank < size_) {
+                keys_[slot] = it->first;
+                values_[slot] = it->second;
+                max_key_ = it->first;
+                max_slot_ = slot;
+                ++it;
+                ++rank;
+            }
+            else {
+                keys_[slot] = (std::is_floating_point_v<Key> ? std::numeric_limits<Key>::infinity() : std::numeric_limits<Key>::max());
+            }
+        }
+        build(it, rank, child(k, node_size));
+    }
+
+    /**
+     * Goes down the tree, keeping the last key not greater than `key`: the keys of the child
+     * taken are all greater than it. The vector kernels below only differ in how they count the
+     * keys of a node.
+     */
+    static size_type find_scalar(const Key* keys, size_type n_nodes, Key key)
+    {
+        size_type slot = npos;
+        size_type k = 0;
+
+        while (k < n_nodes) {
+            const Key* node = keys + k * node_size;
+            size_type i = 0;
+            for (size_type j = 0; j < node_size; j++)  i += !(key < node[j]);
+
+            if (i > 0)  slot = k * node_size + i - 1;
+            k = child(k, i);
+        }
+        return slot;
+    }
+
+#ifdef SIMD_INTERVAL_MAP_X86
+    __attribute__((target("avx2")))
+    static size_type find_avx2(const Key* keys, size_type n_nodes, Key key)
+    {
+        size_type slot = npos;
+        size_type k = 0;
+
+        while (k < n_nodes) {
+            const Key* node = keys + k * node_size;
+            unsigned greater;
+
+            if constexpr (std::is_same_v<Key, float>) {
+                const __m256 x = _mm256_set1_ps(key);
+                greater = static_cast<unsigned>(_mm256_movemask_ps(_mm256_cmp_ps(_mm256_load_ps(node), x, _CMP_GT_OQ))) |
+                    static_cast<unsigned>(_mm256_movemask_ps(_mm256_cmp_ps(_mm256_load_ps(node + 8), x, _CMP_GT_OQ))) << 8;
+            }
+            else if constexpr (std::is_same_v<Key, std::int32_t>) {
+                const __m256i x = _mm256_set1_epi32(key);
+                const __m256i a = _mm256_load_si256(reinterpret_cast<const __m256i*>(node));
+                const __m256i b = _mm256_load_si256(reinterpret_cast<const __m256i*>(node + 8));
+                greater = static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(a, x)))) |
+                    static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(b, x)))) << 8;
+            }
+            else {
+                const __m256i x = _mm256_set1_epi64x(key);
+                const __m256i a = _mm256_load_si256(reinterpret_cast<const __m256i*>(node));
+                const __m256i b = _mm256_load_si256(reinterpret_cast<const __m256i*>(node + 4));
+                greater = static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(a, x)))) |
+                    static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(b, x)))) << 4;
+            }
+
+            const size_type i = node_size - static_cast<size_type>(__builtin_popcount(greater));
+            if (i > 0)  slot = k * node_size + i - 1;
+            k = child(k, i);
+        }
+        return slot;
+    }
+
+    __attribute__((target("avx512f")))
+    static size_type find_avx512(const Key* keys, size_type n_nodes, Key key)
+    {
+        size_type slot = npos;
+        size_type k = 0;
+
+        while (k < n_nodes) {
+            const Key* node = keys + k * node_size;
+            unsigned greater;
+
+            if constexpr (std::is_same_v<Key, float>) {
+                greater = _mm512_cmp_ps_mask(_mm512_load_ps(node), _mm512_set1_ps(key), _CMP_GT_OQ);
+            }
+            else if constexpr (std::is_same_v<Key, std::int32_t>) {
+                greater = _mm512_cmpgt_epi32_mask(_mm512_load_si512(node), _mm512_set1_epi32(key));
+            }
+            else {
+                greater = _mm512_cmpgt_epi64_mask(_mm512_load_si512(node), _mm512_set1_epi64(key));
+            }
+
+            const size_type i = node_size - static_cast<size_type>(__builtin_popcount(greater));
+            if (i > 0)  slot = k * node_size + i - 1;
+            k = child(k, i);
+        }
+        return slot;
+    }
+#endif
+};
+
+template<class Key, class T, class Allocator, class Container>
+simd_interval_map(const interval_map<Key, T, std::less<Key>, Allocator, Container>&) -> simd_interval_map<Key, T>;
+
+#undef SIMD_INTERVAL_MAP_X86
+
+#endif
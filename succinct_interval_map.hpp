@@ -0,0 +1,259 @@
+#ifndef _SUCCINCT_INTERVAL_MAP_HPP
+#define _SUCCINCT_INTERVAL_MAP_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "interval_map.hpp"
+
+/**
+ * Class implementing an immutable snapshot of an interval map of integer keys, storing the keys
+ * in compressed form.
+ *
+ * The keys are stored with the Elias-Fano encoding, as offsets from the first key: each offset
+ * is split into its `low_bits_` low bits, packed in an array, and its high bits, stored in unary
+ * in a bit vector where the i-th key sets bit `(offset >> low_bits_) + i`. With n keys spanning
+ * u values, this takes about 2 + log2(u / n) bits per key. The zeros of the bit vector separate
+ * the keys by high bits, and the position of every `select_sample`-th zero is sampled, so `at`
+ * finds the keys sharing the high bits of the searched one by scanning a few words from a
+ * sample, and binary searches their low bits.
+ *
+ * @tparam Key The type of the key, an integral type ordered by std::less
+ * @tparam T The type of the values
+ */
+template<class Key, class T>
+class succinct_interval_map
+{
+    static_assert(std::is_integral_v<Key>, "succinct_interval_map requires integral keys");
+
+public:
+    using key_type = Key;
+    using mapped_type = T;
+    using size_type = std::size_t;
+
+    /**
+     * Number of zeros of the high bits between two sampled positions.
+     */
+    static constexpr size_type select_sample = 64;
+
+protected:
+    /**
+     * Number of keys.
+     */
+    size_type size_{ 0 };
+
+    /**
+     * First and last keys.
+     */
+    Key min_key_{};
+    Key max_key_{};
+
+    /**
+     * Number of low bits of the offsets stored in low_.
+     */
+    unsigned low_bits_{ 0 };
+
+    /**
+     * Packed low bits of the offsets, `low_bits_` bits per key.
+     */
+    std::vector<std::uint64_t> low_{};
+
+    /**
+     * High bits of the offsets, in unary.
+     */
+    std::vector<std::uint64_t> high_{};
+
+    /**
+     * Positions in high_ of the zeros of rank 0, select_sample, 2 * select_sample, ...
+     */
+    std::vector<std::uint64_t> zero_samples_{};
+
+    /**
+     * Values, where values_[i] is the value of the i-th key.
+     */
+    std::vector<T> values_{};
+
+    T first_val_{};
+    bool has_first_val_{ false };
+
+public:
+    /**
+     * Constructor.
+     *
+     * @param imap the interval map to be snapshotted
+     */
+    template<class Allocator, class Container>
+    explicit succinct_interval_map(const interval_map<Key, T, std::less<Key>, Allocator, Container>& imap) :
+        size_(imap.size()),
+        has_first_val_(imap.has_first_val())
+    {
+        if (has_first_val_)  first_val_ = imap.get_first_val();
+        if (size_ == 0)  return;
+
+        min_key_ = imap.begin()->first;
+        max_key_ = std::prev(imap.end())->first;
+
+        const std::uint64_t universe = offset(max_key_);
+        for (std::uint64_t ratio = universe / size_; ratio > 1; ratio >>= 1)  low_bits_++;
+
+        const std::uint64_t high_size = size_ + (universe >> low_bits_) + 1;
+        high_.assign(high_size / 64 + 1, 0);
+        low_.assign((size_ * low_bits_) / 64 + 1, 0);
+        values_.reserve(size_);
+
+        size_type i = 0;
+        for (const auto& pair : imap) {
+            const std::uint64_t x = offset(pair.first);
+            const std::uint64_t pos = (x >> low_bits_) + i;
+            high_[pos / 64] |= std::uint64_t(1) << (pos % 64);
+            if (low_bits_ > 0)  set_low(i, x & low_mask());
+            values_.push_back(pair.second);
+            i++;
+        }
+
+        size_type zeros = 0;
+        for (std::uint64_t pos = 0; pos < high_size; pos++) {
+            if (high_[pos / 64] >> (pos % 64) & 1)  continue;
+            if (zeros % select_sample == 0)  zero_samples_.push_back(pos);
+            zeros++;
+        }
+    }
+
+    size_type size() const noexcept { return size_; }
+
+    /**
+     * Checks whether the first value is set.
+     *
+     * @return true if a first value has been assigned, false otherwise
+     */
+    bool has_first_val() const noexcept { return has_first_val_; }
+
+    /**
+     * Returns the memory used by the keys, the index and the values, in bytes.
+     */
+    size_type memory_usage() const noexcept
+    {
+        return sizeof(*this) + (low_.capacity() + high_.capacity() + zero_samples_.capacity()) * sizeof(std::uint64_t) +
+            values_.capacity() * sizeof(T);
+    }
+
+    /**
+     * Returns a const reference to the value that is mapped to a key equivalent to `key`.
+     *
+     * @param key the key of the element to find
+     * @return a const reference to the same value that the snapshotted map returns for `key`
+     */
+    const mapped_type& at(const key_type& key) const
+    {
+        if (size_ == 0 || key < min_key_) {
+            if (!has_first_val_)  throw std::out_of_range("succinct_interval_map::at");
+            return first_val_;
+        }
+        if (!(key < max_key_))  return values_[size_ - 1];
+
+        // The keys whose high bits are h are the ones between the zeros of rank h - 1 and h
+        const std::uint64_t x = offset(key);
+        const std::uint64_t h = x >> low_bits_;
+        const size_type bucket_begin = (h == 0 ? 0 : select_zero(h - 1) + 1);
+        size_type lo = bucket_begin - h;
+        size_type hi = next_zero(bucket_begin) - h;
+
+        // The predecessor is the last key of the bucket whose low bits are not greater, or the
+        // last key of the previous buckets, as min_key_ <= key
+        const std::uint64_t x_low = x & low_mask();
+        while (lo < hi) {
+            const size_type mid = lo + (hi - lo) / 2;
+            if (get_low(mid) <= x_low)  lo = mid + 1;
+            else  hi = mid;
+        }
+        return values_[lo - 1];
+    }
+
+private:
+    std::uint64_t offset(const Key& key) const noexcept
+    {
+        return static_cast<std::uint64_t>(key) - static_cast<std::uint64_t>(min_key_);
+    }
+
+    std::uint64_t low_mask() const noexcept { return (std::uint64_t(1) << low_bits_) - 1; }
+
+    void set_low(size_type i, std::uint64_t bits)
+    {
+        const std::uint64_t pos = static_cast<std::uint64_t>(i) * low_bits_;
+        low_[pos / 64] |= bits << (pos % 64);
+        if (pos % 64 + low_bits_ > 64)  low_[pos / 64 + 1] |= bits >> (64 - pos % 64);
+    }
+
+    std::uint64_t get_low(size_type i) const noexcept
+    {
+        if (low_bits_ == 0)  return 0;
+
+        const std::uint64_t pos = static_cast<std::uint64_t>(i) * low_bits_;
+        std::uint64_t bits = low_[pos / 64] >> (pos % 64);
+        if (pos % 64 + low_bits_ > 64)  bits |= low_[pos / 64 + 1] << (64 - pos % 64);
+        return bits & low_mask();
+    }
+
+    /**
+     * Returns the position in high_ of the zero of rank `rank`, scanning the words from the
+     * previous sample.
+     */
+    size_type select_zero(std::uint64_t rank) const noexcept
+    {
+        std::uint64_t pos = zero_samples_[rank / select_sample];
+        std::uint64_t left = rank % select_sample;
+
+        // Zeros of the word from pos on
+        size_type w = pos / 64;
+        std::uint64_t zeros = ~high_[w] & (~std::uint64_t(0) << (pos % 64));
+        for (std::uint64_t count = popcount(zeros); count <= left; count = popcount(zeros)) {
+            left -= count;
+            zeros = ~high_[++w];
+        }
+
+        for (; left > 0; left--)  zeros &= zeros - 1;
+        return w * 64 + ctz(zeros);
+    }
+
+    /**
+     * Returns the position in high_ of the first zero from `pos` on.
+     */
+    size_type next_zero(size_type pos) const noexcept
+    {
+        size_type w = pos / 64;
+        std::uint64_t zeros = ~high_[w] & (~std::uint64_t(0) << (pos % 64));
+        while (zeros == 0)  zeros = ~high_[++w];
+        return w * 64 + ctz(zeros);
+    }
+
+    static std::uint64_t popcount(std::uint64_t x) noexcept
+    {
+#if defined(__GNUC__)
+        return static_cast<std::uint64_t>(__builtin_popcountll(x));
+#else
+        std::uint64_t n = 0;
+        for (; x != 0; x &= x - 1)  n++;
+        return n;
+#endif
+    }
+
+    static size_type ctz(std::uint64_t x) noexcept
+    {
+#if defined(__GNUC__)
+        return static_cast<size_type>(__builtin_ctzll(x));
+#else
+        size_type n = 0;
+        for (; (x & 1) == 0; x >>= 1)  n++;
+        return n;
+#endif
+    }
+};
+
+template<class Key, class T, class Allocator, class Container>
+succinct_interval_map(const interval_map<Key, T, std::less<Key>, Allocator, Container>&) -> succinct_interval_map<Key, T>;
+
+#endif
@@ -1,11 +1,41 @@
+#include <algorithm>
+#include <atomic>
 #include <cassert>
-#include <chrono>
 #include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <memory>
+#include <optional>
 #include <ostream>
+#include <random>
+#include <set>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <tuple>
 #include <vector>
 
+#include "aggregate_interval_map.hpp"
+#include "buffered_interval_map.hpp"
+#include "concurrent_interval_map.hpp"
+#include "frozen_interval_map.hpp"
+#include "interned_interval_map.hpp"
 #include "interval_map.hpp"
+#include "interval_map_diff.hpp"
+#include "interval_map_io.hpp"
+#include "journaled_interval_map.hpp"
+#include "persistent_interval_map.hpp"
+#include "pool_allocator.hpp"
+#include "sharded_interval_map.hpp"
+#include "simd_interval_map.hpp"
+#include "succinct_interval_map.hpp"
+#include "veb_map.hpp"
 
 #define compare_not_passed( a, b ) { \
     std::cerr << "Test \"" << __FUNCTION__ << "\" not passed on " << a << " and " << b << "\n"; \
@@ -318,23 +348,1409 @@ void test_swap()
 }
 
 
-std::chrono::duration<double> benchmark_imap(
-    interval_map<int, int>& imap,
-    int n_tests,
-    int key_begin_size,
-    int key_end_size,
-    int val_size
-)
+void test_at()
 {
-    const auto start{ std::chrono::steady_clock::now() };
-    for (int i = 0; i < n_tests; i++) {
-        imap.insert_range(rand() % key_begin_size, rand() % key_end_size, rand() % val_size);
+    interval_map<int, char> imap('A', { {3, 'B'}, {6, 'C'}, {9, 'A'} });
+
+    if (imap.at(2) != 'A')  compare_not_passed(imap.at(2), 'A');
+    if (imap.at(3) != 'B')  compare_not_passed(imap.at(3), 'B');
+    if (imap.at(8) != 'C')  compare_not_passed(imap.at(8), 'C');
+    if (imap.at(100) != 'A')  compare_not_passed(imap.at(100), 'A');
+}
+
+void test_at_without_first_val()
+{
+    interval_map<int, char> imap;
+    imap.insert(3, 'B');
+
+    if (imap.at(3) != 'B')  compare_not_passed(imap.at(3), 'B');
+
+    try {
+        imap.at(2);
+        compare_not_passed("at(2)", "out_of_range");
+    }
+    catch (const std::out_of_range&) {}
+}
+
+
+void test_flat_insert_range()
+{
+    flat_interval_map<int, char> ref_imap('A', { {3, 'B'}, {5, 'D'}, {7, 'C'}, {9, 'B'}, {12, 'A'} });
+
+    flat_interval_map<int, char> imap('A');
+    imap.insert_range(3, 12, 'B');
+    imap.insert_range(6, 9, 'C');
+    imap.insert_range(5, 7, 'D');
+
+    assert_ref(imap, ref_imap);
+    if (imap.at(6) != 'D')  compare_not_passed(imap.at(6), 'D');
+}
+
+void test_flat_insert_overwrite_same_as_prev()
+{
+    flat_interval_map<int, char> ref_imap('A', { {3, 'B'}, {9, 'A'} });
+
+    flat_interval_map<int, char> imap('A', { {3, 'B'}, {6, 'C'}, {9, 'A'} });
+    imap.insert(6, 'B');
+
+    assert_ref(imap, ref_imap);
+}
+
+void test_flat_matches_map()
+{
+    interval_map<int, int> imap(0);
+    flat_interval_map<int, int> flat_imap(0);
+
+    std::srand(1);
+    for (int i = 0; i < 2000; i++) {
+        int key_begin = rand() % 100, key_end = rand() % 100, val = rand() % 5;
+        imap.insert_range(key_begin, key_end, val);
+        flat_imap.insert_range(key_begin, key_end, val);
+        if (i % 7 == 0) {
+            imap.insert(key_end, val);
+            flat_imap.insert(key_end, val);
+        }
+    }
+
+    if (!std::equal(imap.begin(), imap.end(), flat_imap.begin(), flat_imap.end(),
+        [](const auto& a, const auto& b) { return a.first == b.first && a.second == b.second; })) {
+        compare_not_passed(imap, flat_imap);
+    }
+
+    for (int key = -1; key <= 100; key++) {
+        if (imap.at(key) != flat_imap.at(key))  compare_not_passed(imap.at(key), flat_imap.at(key));
+    }
+}
+
+
+/**
+ * Value whose copies throw while `fail` is set.
+ */
+struct throwing_value
+{
+    static inline bool fail = false;
+    int val;
+
+    throwing_value(int v) : val(v) {}
+    throwing_value(const throwing_value& other) : val(other.val)
+    {
+        if (fail)  throw std::runtime_error("throwing_value");
+    }
+    throwing_value& operator=(const throwing_value&) = default;
+};
+
+void test_flat_emplace_exception_safety()
+{
+    flat_map<int, throwing_value> fmap;
+    for (int key : { 1, 3, 5 })  fmap.emplace(key, throwing_value(key * 10));
+
+    throwing_value::fail = true;
+    const throwing_value val(40);
+    bool thrown = false;
+    try {
+        fmap.emplace(2, val);
+    }
+    catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    throwing_value::fail = false;
+
+    if (!thrown)  compare_not_passed("emplace", "std::runtime_error");
+    if (fmap.size() != 3 || fmap.keys().size() != 3)  compare_not_passed(fmap.keys().size(), 3);
+    for (const auto& pair : fmap) {
+        if (pair.second.val != pair.first * 10)  compare_not_passed(pair.first, pair.second.val);
+    }
+}
+
+void test_insert_ranges()
+{
+    interval_map<int, char> ref_imap('A', { {3, 'B'}, {5, 'D'}, {7, 'C'}, {9, 'B'}, {12, 'A'} });
+
+    std::vector<std::tuple<int, int, char>> ranges = { {3, 12, 'B'}, {6, 9, 'C'}, {5, 7, 'D'}, {8, 8, 'E'} };
+    interval_map<int, char> imap('A');
+    imap.insert_ranges(ranges.begin(), ranges.end());
+
+    assert_ref(imap, ref_imap);
+}
+
+template<class IntervalMap>
+void check_insert_ranges_matches_insert_range(int n_prefill, int n_ranges)
+{
+    IntervalMap ref_imap(0);
+    for (int i = 0; i < n_prefill; i++) {
+        ref_imap.insert_range(rand() % 1000, rand() % 1000, rand() % 4);
+    }
+    IntervalMap imap = ref_imap;
+
+    std::vector<std::tuple<int, int, int>> ranges;
+    for (int i = 0; i < n_ranges; i++) {
+        ranges.emplace_back(rand() % 1000, rand() % 1000, rand() % 4);
+        ref_imap.insert_range(std::get<0>(ranges.back()), std::get<1>(ranges.back()), std::get<2>(ranges.back()));
+    }
+    imap.insert_ranges(ranges.begin(), ranges.end());
+
+    assert_ref(imap, ref_imap);
+}
+
+void test_insert_ranges_matches_insert_range()
+{
+    std::srand(2);
+    for (int i = 0; i < 50; i++) {
+        check_insert_ranges_matches_insert_range<interval_map<int, int>>(500, 3);
+        check_insert_ranges_matches_insert_range<interval_map<int, int>>(100, 200);
+        check_insert_ranges_matches_insert_range<flat_interval_map<int, int>>(100, 200);
+    }
+}
+
+void test_insert_ranges_without_first_val()
+{
+    std::vector<std::tuple<int, int, char>> ranges = { {6, 9, 'C'}, {1, 4, 'B'} };
+    interval_map<int, char> imap;
+    imap.insert(5, 'A');
+
+    try {
+        imap.insert_ranges(ranges.begin(), ranges.end());
+        compare_not_passed("insert_ranges", "out_of_range");
+    }
+    catch (const std::out_of_range&) {}
+
+    if (imap.size() != 1)  compare_not_passed(imap.size(), 1);
+
+    // Each interval may start before the first key as long as it reaches it, moving it left
+    interval_map<int, char> grown;
+    grown.insert(10, 'Z');
+    std::vector<std::tuple<int, int, char>> left_ranges = { {5, 10, 'A'}, {0, 5, 'B'} };
+    grown.insert_ranges(left_ranges.begin(), left_ranges.end());
+
+    interval_map<int, char> ref_grown;
+    ref_grown.insert(10, 'Z');
+    ref_grown.insert_range(5, 10, 'A');
+    ref_grown.insert_range(0, 5, 'B');
+    assert_ref(grown, ref_grown);
+
+    // The intervals are checked in order, even if a later one covers an earlier one
+    std::vector<std::tuple<int, int, char>> covered_ranges = { {0, 5, 'B'}, {0, 12, 'A'} };
+    try {
+        ref_grown = interval_map<int, char>();
+        ref_grown.insert(10, 'Z');
+        ref_grown.insert_ranges(covered_ranges.begin(), covered_ranges.end());
+        compare_not_passed("insert_ranges", "out_of_range");
+    }
+    catch (const std::out_of_range&) {}
+}
+
+/**
+ * Checks that `insert_ranges` on a map without first value throws exactly when calling
+ * `insert_range` on each interval in order throws, and otherwise gives the same map.
+ */
+template<class IntervalMap>
+void check_insert_ranges_without_first_val(std::size_t n_ranges, std::size_t n_threads)
+{
+    IntervalMap ref_imap;
+    ref_imap.insert(5000, 0);
+    for (int i = 0; i < 100; i++) {
+        const int key_begin = 5000 + rand() % 5000;
+        ref_imap.insert_range(key_begin, key_begin + rand() % 100, rand() % 4);
+    }
+    IntervalMap imap = ref_imap;
+
+    // Intervals growing the map to the left, mixed with intervals after its first key, and
+    // sometimes one too far to the left
+    std::vector<std::tuple<int, int, int>> ranges;
+    int first_key = 5000;
+    for (std::size_t i = 0; i < n_ranges; i++) {
+        if (rand() % 2 == 0) {
+            const int key_begin = 5000 + rand() % 5000;
+            ranges.emplace_back(key_begin, key_begin + rand() % 100, rand() % 4);
+        }
+        else {
+            const int key_begin = first_key - rand() % 3;
+            const int key_end = (rand() % 2000 == 0 ? key_begin - 1 : first_key + rand() % 3);
+            ranges.emplace_back(key_begin, key_end, rand() % 4);
+            first_key = std::min(first_key, key_begin);
+        }
+    }
+
+    bool ref_thrown = false;
+    try {
+        for (const auto& range : ranges)  ref_imap.insert_range(std::get<0>(range), std::get<1>(range), std::get<2>(range));
+    }
+    catch (const std::out_of_range&) {
+        ref_thrown = true;
+    }
+
+    bool thrown = false;
+    try {
+        if (n_threads > 1)  imap.insert_ranges(ranges.begin(), ranges.end(), n_threads);
+        else  imap.insert_ranges(ranges.begin(), ranges.end());
+    }
+    catch (const std::out_of_range&) {
+        thrown = true;
+    }
+
+    if (thrown != ref_thrown)  compare_not_passed(thrown, ref_thrown);
+    if (!thrown)  assert_ref(imap, ref_imap);
+}
+
+void test_insert_ranges_without_first_val_matches_insert_range()
+{
+    std::srand(2);
+    for (int i = 0; i < 20; i++) {
+        for (std::size_t n_ranges : { 3, 50, 1000 }) {
+            check_insert_ranges_without_first_val<interval_map<int, int>>(n_ranges, 1);
+            check_insert_ranges_without_first_val<flat_interval_map<int, int>>(n_ranges, 1);
+        }
+        check_insert_ranges_without_first_val<interval_map<int, int>>(10000, 3);
+        check_insert_ranges_without_first_val<flat_interval_map<int, int>>(10000, 3);
+    }
+}
+
+template<class IntervalMap>
+void check_parallel_insert_ranges(int key_range, std::size_t n_threads)
+{
+    IntervalMap ref_imap;
+    ref_imap.insert(key_range / 10, 0);
+    for (int i = 0; i < 1000; i++) {
+        const int key_begin = key_range / 10 + rand() % key_range;
+        ref_imap.insert_range(key_begin, key_begin + rand() % 100, rand() % 4);
+    }
+    IntervalMap imap = ref_imap;
+
+    std::vector<std::tuple<int, int, int>> ranges;
+    for (int i = 0; i < 20000; i++) {
+        const int key_begin = key_range / 10 + rand() % key_range;
+        ranges.emplace_back(key_begin, key_begin + rand() % (key_range / 20 + 1), rand() % 4);
+    }
+    ref_imap.insert_ranges(ranges.begin(), ranges.end());
+    imap.insert_ranges(ranges.begin(), ranges.end(), n_threads);
+
+    assert_ref(imap, ref_imap);
+}
+
+void test_parallel_insert_ranges()
+{
+    std::srand(19);
+    for (std::size_t n_threads : { 2, 3, 8 }) {
+        for (int key_range : { 20, 1000, 1000000 }) {
+            check_parallel_insert_ranges<interval_map<int, int>>(key_range, n_threads);
+            check_parallel_insert_ranges<flat_interval_map<int, int>>(key_range, n_threads);
+        }
+    }
+
+    // Intervals before the first pair of a map without first value
+    std::vector<std::tuple<int, int, int>> ranges;
+    for (int i = 0; i < 20000; i++)  ranges.emplace_back(i, i + 1, i % 2);
+    interval_map<int, int> imap;
+    imap.insert(10000, 5);
+
+    try {
+        imap.insert_ranges(ranges.begin(), ranges.end(), 4);
+        compare_not_passed("insert_ranges", "out_of_range");
+    }
+    catch (const std::out_of_range&) {}
+
+    if (imap.size() != 1)  compare_not_passed(imap.size(), 1);
+}
+
+
+template<class IntervalMap>
+void check_at_many_matches_at(std::vector<int> keys)
+{
+    IntervalMap imap(0);
+    for (int i = 0; i < 300; i++) {
+        imap.insert_range(rand() % 1000, rand() % 1000, rand() % 4);
+    }
+
+    std::vector<int> vals;
+    imap.at_many(keys.begin(), keys.end(), std::back_inserter(vals));
+
+    for (std::size_t i = 0; i < keys.size(); i++) {
+        if (vals[i] != imap.at(keys[i]))  compare_not_passed(vals[i], imap.at(keys[i]));
+    }
+}
+
+void test_at_many()
+{
+    std::srand(3);
+
+    std::vector<int> keys;
+    for (int i = 0; i < 2000; i++)  keys.push_back(rand() % 1100 - 50);
+    std::vector<int> sorted_keys = keys;
+    std::sort(sorted_keys.begin(), sorted_keys.end());
+
+    check_at_many_matches_at<interval_map<int, int>>(sorted_keys);
+    check_at_many_matches_at<flat_interval_map<int, int>>(sorted_keys);
+    check_at_many_matches_at<interval_map<int, int>>(keys);
+    check_at_many_matches_at<flat_interval_map<int, int>>(keys);
+}
+
+
+void test_frozen()
+{
+    std::srand(4);
+
+    for (int n_ranges : { 0, 1, 2, 50, 500 }) {
+        interval_map<int, int> imap(-1);
+        for (int i = 0; i < n_ranges; i++) {
+            imap.insert_range(rand() % 1000, rand() % 1000, rand() % 4);
+        }
+
+        frozen_interval_map frozen(imap);
+        if (frozen.size() != imap.size())  compare_not_passed(frozen.size(), imap.size());
+
+        for (int key = -10; key <= 1010; key++) {
+            if (frozen.at(key) != imap.at(key))  compare_not_passed(frozen.at(key), imap.at(key));
+        }
+    }
+}
+
+void test_frozen_without_first_val()
+{
+    interval_map<int, char> imap;
+    imap.insert(3, 'B');
+    imap.insert(6, 'C');
+
+    frozen_interval_map frozen(imap);
+    if (frozen.at(3) != 'B')  compare_not_passed(frozen.at(3), 'B');
+    if (frozen.at(7) != 'C')  compare_not_passed(frozen.at(7), 'C');
+
+    try {
+        frozen.at(2);
+        compare_not_passed("at(2)", "out_of_range");
+    }
+    catch (const std::out_of_range&) {}
+}
+
+/**
+ * Comparator ordering the keys in ascending or descending order, depending on its state.
+ */
+struct directed_less
+{
+    bool descending{ false };
+
+    bool operator()(int a, int b) const { return descending ? b < a : a < b; }
+};
+
+void test_frozen_keeps_comparator()
+{
+    using map_type = interval_map<int, char, directed_less>;
+    map_type imap('A', map_type::container_type(directed_less{ true }));
+    imap.insert(9, 'B');
+    imap.insert(6, 'C');
+    imap.insert(2, 'D');
+
+    frozen_interval_map frozen(imap);
+    for (int key = -2; key <= 12; key++) {
+        if (frozen.at(key) != imap.at(key))  compare_not_passed(frozen.at(key), imap.at(key));
+    }
+}
+
+
+void test_concurrent_readers()
+{
+    concurrent_interval_map<int, int> cmap(0);
+    std::atomic<bool> done{ false };
+    std::atomic<bool> consistent{ true };
+
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 4; i++) {
+        readers.emplace_back([&]() {
+            auto reader = cmap.make_reader();
+            while (!done) {
+                // Every version maps [0, 100) to a single value
+                bool ok = reader.read([](const interval_map<int, int>& imap) {
+                    return imap.at(0) == imap.at(50) && imap.at(50) == imap.at(99);
+                });
+                if (!ok)  consistent = false;
+            }
+        });
+    }
+
+    for (int i = 1; i <= 1000; i++) {
+        cmap.update([i](interval_map<int, int>& imap) {
+            imap.insert_range(0, 50, i);
+            imap.insert_range(50, 100, i);
+        });
+    }
+    done = true;
+
+    for (auto& reader : readers)  reader.join();
+
+    if (!consistent)  compare_not_passed("readers", "consistent versions");
+
+    auto reader = cmap.make_reader();
+    if (reader.at(42) != 1000)  compare_not_passed(reader.at(42), 1000);
+    if (reader.at(100) != 0)  compare_not_passed(reader.at(100), 0);
+}
+
+void test_concurrent_reader_slots()
+{
+    concurrent_interval_map<int, int> cmap(0, 2);
+    {
+        auto a = cmap.make_reader();
+        auto b = cmap.make_reader();
+
+        try {
+            auto c = cmap.make_reader();
+            compare_not_passed("make_reader", "runtime_error");
+        }
+        catch (const std::runtime_error&) {}
+    }
+
+    auto a = cmap.make_reader();
+    cmap.insert_range(1, 3, 5);
+    if (a.at(2) != 5)  compare_not_passed(a.at(2), 5);
+}
+
+
+void test_sharded_insert_range_across_shards()
+{
+    interval_map<int, char> ref_imap('A', { {5, 'B'}, {25, 'A'} });
+
+    sharded_interval_map<int, char> smap('A', { 20, 10 });
+    smap.insert_range(5, 25, 'B');
+
+    assert_ref(smap.to_interval_map(), ref_imap);
+    if (smap.at(10) != 'B')  compare_not_passed(smap.at(10), 'B');
+    if (smap.at(25) != 'A')  compare_not_passed(smap.at(25), 'A');
+
+    smap.insert_range(10, 20, 'C');
+    smap.insert_range(10, 20, 'B');
+    assert_ref(smap.to_interval_map(), ref_imap);
+}
+
+void test_sharded_keeps_comparator()
+{
+    sharded_interval_map<int, char, directed_less> smap('A', { 20, 10 }, directed_less{ true });
+    if (smap.at(15) != 'A')  compare_not_passed(smap.at(15), 'A');
+
+    const auto imap = smap.to_interval_map();
+    if (!imap.key_comp().descending)  compare_not_passed(imap.key_comp().descending, true);
+    if (imap.at(15) != 'A')  compare_not_passed(imap.at(15), 'A');
+}
+
+void test_sharded_parallel_writers()
+{
+    interval_map<int, int> ref_imap(0);
+    sharded_interval_map<int, int> smap(0, { 250, 500, 750 });
+
+    std::vector<std::vector<std::tuple<int, int, int>>> ranges(4);
+    std::srand(5);
+    for (int t = 0; t < 4; t++) {
+        for (int i = 0; i < 500; i++) {
+            // Each writer stays in its own region, so the result does not depend on scheduling
+            int key_begin = t * 250 + rand() % 250;
+            int key_end = std::min(key_begin + rand() % 50, (t + 1) * 250);
+            ranges[t].emplace_back(key_begin, key_end, rand() % 3);
+            ref_imap.insert_range(key_begin, key_end, std::get<2>(ranges[t].back()));
+        }
+    }
+
+    std::vector<std::thread> writers;
+    for (int t = 0; t < 4; t++) {
+        writers.emplace_back([&smap, &ranges, t]() {
+            for (const auto& [key_begin, key_end, val] : ranges[t])  smap.insert_range(key_begin, key_end, val);
+        });
+    }
+    for (auto& writer : writers)  writer.join();
+
+    assert_ref(smap.to_interval_map(), ref_imap);
+}
+
+
+void test_pooled_matches_map()
+{
+    interval_map<int, int> imap(0);
+    pooled_interval_map<int, int> pooled_imap(0);
+
+    std::srand(6);
+    for (int i = 0; i < 5000; i++) {
+        int key_begin = rand() % 1000, key_end = rand() % 1000, val = rand() % 5;
+        imap.insert_range(key_begin, key_end, val);
+        pooled_imap.insert_range(key_begin, key_end, val);
+    }
+
+    pooled_interval_map<int, int> pooled_copy = pooled_imap;
+    if (!std::equal(imap.begin(), imap.end(), pooled_copy.begin(), pooled_copy.end()))  compare_not_passed(imap, pooled_copy);
+}
+
+void test_pool_allocator_reuses_blocks()
+{
+    auto pool = std::make_shared<node_pool>();
+    std::map<int, int, std::less<int>, pool_allocator<std::pair<const int, int>>> map{ pool_allocator<std::pair<const int, int>>(pool) };
+
+    for (int round = 0; round < 100; round++) {
+        for (int i = 0; i < 100; i++)  map.emplace(i, i);
+        map.clear();
+    }
+
+    // 100 nodes fit in a single chunk, which is reused by every round
+    if (pool->upstream_allocations() != 1)  compare_not_passed(pool->upstream_allocations(), 1);
+}
+
+
+void test_interned()
+{
+    interned_interval_map<int, std::string> imap("none");
+    imap.insert_range(3, 12, "policy B");
+    imap.insert_range(6, 9, "policy C");
+    imap.insert_range(9, 20, "policy B");
+
+    if (imap.at(0) != "none")  compare_not_passed(imap.at(0), "none");
+    if (imap.at(5) != "policy B")  compare_not_passed(imap.at(5), "policy B");
+    if (imap.at(6) != "policy C")  compare_not_passed(imap.at(6), "policy C");
+    if (imap.at(15) != "policy B")  compare_not_passed(imap.at(15), "policy B");
+    if (imap.at(20) != "none")  compare_not_passed(imap.at(20), "none");
+    if (imap.size() != 4)  compare_not_passed(imap.size(), 4);
+    if (imap.distinct_values() != 3)  compare_not_passed(imap.distinct_values(), 3);
+}
+
+void test_interned_compact()
+{
+    interned_interval_map<int, std::string> imap("none");
+    imap.insert_range(3, 12, "policy B");
+    imap.insert_range(6, 9, "policy C");
+    imap.set_first_val("policy D");
+    imap.insert_range(0, 20, "policy E");
+    imap.insert_range(5, 6, "policy C");
+
+    imap.compact();
+
+    // "policy B" is gone, while "none" is still mapped after key 20
+    if (imap.distinct_values() != 4)  compare_not_passed(imap.distinct_values(), 4);
+    if (imap.get_first_val() != "policy D")  compare_not_passed(imap.get_first_val(), "policy D");
+    if (imap.at(-1) != "policy D")  compare_not_passed(imap.at(-1), "policy D");
+    if (imap.at(4) != "policy E")  compare_not_passed(imap.at(4), "policy E");
+    if (imap.at(5) != "policy C")  compare_not_passed(imap.at(5), "policy C");
+    if (imap.at(20) != "none")  compare_not_passed(imap.at(20), "none");
+
+    // Interned values still match after renumbering
+    imap.insert_range(6, 20, "policy C");
+    if (imap.size() != 3)  compare_not_passed(imap.size(), 3);
+}
+
+template<class IntervalMap>
+std::vector<std::tuple<int, int, char>> collect_segments(const IntervalMap& imap, int key_begin, int key_end)
+{
+    std::vector<std::tuple<int, int, char>> segments;
+    imap.for_each_segment(key_begin, key_end, [&segments](const int& segment_begin, const int& segment_end, const char& val) {
+        segments.emplace_back(segment_begin, segment_end, val);
+    });
+    return segments;
+}
+
+void test_for_each_segment()
+{
+    interval_map<int, char> imap('A', { {3, 'B'}, {6, 'C'}, {9, 'A'} });
+
+    std::vector<std::tuple<int, int, char>> ref = { {4, 6, 'B'}, {6, 9, 'C'}, {9, 10, 'A'} };
+    if (collect_segments(imap, 4, 10) != ref)  compare_not_passed("segments", "[4, 10)");
+
+    ref = { {0, 3, 'A'}, {3, 5, 'B'} };
+    if (collect_segments(imap, 0, 5) != ref)  compare_not_passed("segments", "[0, 5)");
+
+    ref = { {6, 9, 'C'} };
+    if (collect_segments(imap, 6, 9) != ref)  compare_not_passed("segments", "[6, 9)");
+
+    ref = { {20, 30, 'A'} };
+    if (collect_segments(imap, 20, 30) != ref)  compare_not_passed("segments", "[20, 30)");
+
+    if (!collect_segments(imap, 5, 5).empty())  compare_not_passed("segments", "[5, 5)");
+
+    flat_interval_map<int, char> flat_imap('A', { {3, 'B'}, {6, 'C'}, {9, 'A'} });
+    ref = { {4, 6, 'B'}, {6, 9, 'C'}, {9, 10, 'A'} };
+    if (collect_segments(flat_imap, 4, 10) != ref)  compare_not_passed("flat segments", "[4, 10)");
+}
+
+void test_for_each_segment_without_first_val()
+{
+    interval_map<int, char> imap;
+    imap.insert(3, 'B');
+    imap.insert(6, 'C');
+
+    std::vector<std::tuple<int, int, char>> ref = { {3, 6, 'B'}, {6, 8, 'C'} };
+    if (collect_segments(imap, 0, 8) != ref)  compare_not_passed("segments", "[0, 8)");
+
+    if (!collect_segments(imap, 0, 3).empty())  compare_not_passed("segments", "[0, 3)");
+}
+
+void test_merge()
+{
+    interval_map<int, int> ref_imap(1, { {3, 5}, {8, 7}, {12, 2} });
+
+    interval_map<int, int> lhs(1, { {3, 5}, {10, 2} });
+    interval_map<int, int> rhs(0, { {6, 4}, {8, 7}, {12, 0} });
+
+    assert_ref(merge(lhs, rhs, [](int a, int b) { return std::max(a, b); }), ref_imap);
+}
+
+void test_merge_coalesces()
+{
+    interval_map<int, char> ref_imap('A', { {6, 'C'}, {9, 'A'} });
+
+    // Overlay: rhs overrides lhs where it is not '-'
+    interval_map<int, char> lhs('A', { {3, 'B'}, {6, 'A'} });
+    interval_map<int, char> rhs('-', { {3, 'A'}, {6, 'C'}, {9, '-'} });
+
+    assert_ref(merge(lhs, rhs, [](char a, char b) { return b == '-' ? a : b; }), ref_imap);
+}
+
+void test_merge_matches_at()
+{
+    std::srand(7);
+    flat_interval_map<int, int> lhs(0);
+    flat_interval_map<int, int> rhs(1);
+    for (int i = 0; i < 300; i++) {
+        lhs.insert_range(rand() % 1000, rand() % 1000, rand() % 4);
+        rhs.insert_range(rand() % 1000, rand() % 1000, rand() % 4);
+    }
+
+    auto sum = [](int a, int b) { return a + b; };
+    flat_interval_map<int, int> merged = merge(lhs, rhs, sum);
+
+    for (int key = -1; key <= 1000; key++) {
+        if (merged.at(key) != lhs.at(key) + rhs.at(key))  compare_not_passed(merged.at(key), lhs.at(key) + rhs.at(key));
+    }
+    for (auto it = merged.begin(); it != merged.end(); it++) {
+        const int prev_val = (it == merged.begin() ? merged.get_first_val() : std::prev(it)->second);
+        if (it->second == prev_val)  compare_not_passed(it->first, it->second);
+    }
+}
+
+void test_merge_without_first_val()
+{
+    auto sum = [](int a, int b) { return a + b; };
+
+    interval_map<int, int> lhs;
+    lhs.insert(3, 1);
+    lhs.insert_range(8, 12, 5);
+    interval_map<int, int> rhs(10);
+    rhs.insert_range(5, 9, 20);
+
+    // Keys before 3 are mapped by rhs only
+    interval_map<int, int> merged = merge(lhs, rhs, sum);
+    if (merged.has_first_val())  compare_not_passed(merged.get_first_val(), "no first value");
+    for (int key = 3; key < 20; key++) {
+        if (merged.at(key) != lhs.at(key) + rhs.at(key))  compare_not_passed(merged.at(key), lhs.at(key) + rhs.at(key));
+    }
+    bool thrown = false;
+    try {
+        merged.at(2);
+    }
+    catch (const std::out_of_range&) {
+        thrown = true;
+    }
+    if (!thrown)  compare_not_passed(2, "out_of_range");
+
+    // The first pair is kept even if it maps to the first value of a map
+    interval_map<int, int> zero(0);
+    interval_map<int, int> one_pair;
+    one_pair.insert(4, 0);
+    interval_map<int, int> merged_pair = merge(one_pair, zero, sum);
+    if (merged_pair.size() != 1 || merged_pair.at(4) != 0)  compare_not_passed(merged_pair.size(), 1);
+
+    interval_map<int, int> empty;
+    if (merge(empty, zero, sum).size() != 0 || merge(empty, zero, sum).has_first_val())  compare_not_passed("merge", "empty map");
+}
+
+void test_merge_keeps_allocator()
+{
+    pooled_interval_map<int, int> lhs(0);
+    pooled_interval_map<int, int> rhs(1);
+    for (int i = 0; i < 100; i++) {
+        lhs.insert_range(i * 10, i * 10 + 5, i % 3);
+        rhs.insert_range(i * 10 + 3, i * 10 + 8, i % 5);
+    }
+
+    pooled_interval_map<int, int> merged = merge(lhs, rhs, [](int a, int b) { return a * 10 + b; });
+    if (merged.get_allocator().pool() != lhs.get_allocator().pool())  compare_not_passed("merge", "allocator of lhs");
+}
+
+template<class Key, class T>
+std::vector<std::pair<Key, T>> collect_pairs(const aggregate_interval_map<Key, T>& amap)
+{
+    std::vector<std::pair<Key, T>> pairs;
+    amap.for_each([&pairs](const Key& key, const T& val) { pairs.emplace_back(key, val); });
+    return pairs;
+}
+
+void test_aggregate_add_range()
+{
+    aggregate_interval_map<int, int> amap(0);
+    amap.add_range(2, 6, 3);
+    amap.add_range(4, 8, 2);
+    amap.add_range(6, 8, 3);
+
+    std::vector<std::pair<int, int>> ref = { {2, 3}, {4, 5}, {8, 0} };
+    if (collect_pairs(amap) != ref)  compare_not_passed("pairs", "add_range");
+
+    if (amap.range_max(0, 3) != 3)  compare_not_passed(amap.range_max(0, 3), 3);
+    if (amap.range_max(3, 10) != 5)  compare_not_passed(amap.range_max(3, 10), 5);
+    if (amap.range_sum(0, 10) != 26)  compare_not_passed(amap.range_sum(0, 10), 26);
+    if (amap.range_sum(5, 6) != 5)  compare_not_passed(amap.range_sum(5, 6), 5);
+
+    // Cancelling the additions leaves no pair
+    amap.add_range(2, 4, -3);
+    amap.add_range(4, 8, -5);
+    if (amap.size() != 0)  compare_not_passed(amap.size(), 0);
+}
+
+void test_aggregate_matches_brute_force()
+{
+    constexpr int key_size = 200;
+    std::srand(11);
+    aggregate_interval_map<int, long long> amap(1);
+    std::vector<long long> ref(key_size + 2, 1);
+
+    for (int i = 0; i < 2000; i++) {
+        const int key_begin = rand() % key_size;
+        const int key_end = key_begin + rand() % 20;
+        const long long val = rand() % 5 - 2;
+        if (rand() % 4 == 0) {
+            amap.insert_range(key_begin, std::min(key_end, key_size), val);
+            for (int key = key_begin; key < std::min(key_end, key_size); key++)  ref[key] = val;
+        }
+        else {
+            amap.add_range(key_begin, std::min(key_end, key_size), val);
+            for (int key = key_begin; key < std::min(key_end, key_size); key++)  ref[key] += val;
+        }
+
+        const int lo = rand() % key_size;
+        const int hi = lo + 1 + rand() % (key_size - lo);
+        long long ref_sum = 0;
+        long long ref_max = ref[lo];
+        for (int key = lo; key < hi; key++) {
+            ref_sum += ref[key];
+            ref_max = std::max(ref_max, ref[key]);
+        }
+        if (amap.range_sum(lo, hi) != ref_sum)  compare_not_passed(amap.range_sum(lo, hi), ref_sum);
+        if (amap.range_max(lo, hi) != ref_max)  compare_not_passed(amap.range_max(lo, hi), ref_max);
+    }
+
+    for (int key = -1; key <= key_size; key++) {
+        const long long val = (key < 0 ? 1 : ref[key]);
+        if (amap.at(key) != val)  compare_not_passed(amap.at(key), val);
+    }
+
+    long long prev_val = amap.get_first_val();
+    for (const auto& pair : collect_pairs(amap)) {
+        if (pair.second == prev_val)  compare_not_passed(pair.first, pair.second);
+        prev_val = pair.second;
+    }
+}
+
+void test_save_load()
+{
+    interval_map<int, char> imap('A', { {1, 'B'}, {3, 'C'}, {6, 'A'} });
+    std::stringstream stream;
+    save_interval_map(imap, stream);
+    interval_map<int, char> loaded = load_interval_map<int, char>(stream);
+    assert_ref(loaded, imap);
+
+    interval_map<int, char> no_first_val;
+    no_first_val.insert(2, 'B');
+    no_first_val.insert_range(4, 6, 'C');
+    std::stringstream no_first_val_stream;
+    save_interval_map(no_first_val, no_first_val_stream, false);
+    interval_map<int, char> loaded_no_first_val = load_interval_map<int, char>(no_first_val_stream);
+    assert_ref(loaded_no_first_val, no_first_val);
+
+    // Corrupting a value is detected by the checksum
+    std::string bytes = stream.str();
+    bytes.back() ^= 1;
+    std::stringstream corrupted(bytes);
+    try {
+        load_interval_map<int, char>(corrupted);
+        compare_not_passed("load_interval_map", "std::runtime_error");
+    }
+    catch (const std::runtime_error&) {}
+}
+
+void test_mapped()
+{
+    std::srand(5);
+    flat_interval_map<long long, int> imap(-1);
+    for (int i = 0; i < 1000; i++)  imap.insert_range(rand() % 10000, rand() % 10000, rand() % 16);
+
+    const std::filesystem::path path = std::filesystem::temp_directory_path() / "interval_map_test.bin";
+    {
+        std::ofstream out(path, std::ios::binary);
+        save_interval_map(imap, out);
+    }
+
+    {
+        mapped_interval_map<long long, int> mapped(path.string(), true);
+        if (mapped.size() != imap.size())  compare_not_passed(mapped.size(), imap.size());
+        for (long long key = -1; key <= 10000; key++) {
+            if (mapped.at(key) != imap.at(key))  compare_not_passed(mapped.at(key), imap.at(key));
+        }
+    }
+
+    // Loading with other types is rejected by the header
+    try {
+        mapped_interval_map<int, int> wrong_key(path.string());
+        compare_not_passed("mapped_interval_map", "std::runtime_error");
+    }
+    catch (const std::runtime_error&) {}
+
+    // A file too short for the header is rejected as an invalid argument
+    std::filesystem::resize_file(path, 4);
+    try {
+        mapped_interval_map<long long, int> truncated(path.string());
+        compare_not_passed("mapped_interval_map", "std::system_error");
     }
-    const auto end{ std::chrono::steady_clock::now() };
-    const std::chrono::duration<double> elapsed_seconds{ end - start };
-    return elapsed_seconds;
+    catch (const std::system_error& e) {
+        if (e.code() != std::errc::invalid_argument)  compare_not_passed(e.code().message(), "invalid argument");
+    }
+
+    std::filesystem::remove(path);
+}
+
+void test_range_constructor_coalesces()
+{
+    interval_map<int, char> ref_imap('A', { {3, 'B'}, {9, 'A'} });
+
+    std::vector<std::pair<int, char>> pairs = { {1, 'A'}, {3, 'B'}, {6, 'B'}, {9, 'A'}, {12, 'A'} };
+    interval_map<int, char> imap('A', pairs.begin(), pairs.end());
+    assert_ref(imap, ref_imap);
+
+    flat_interval_map<int, char> flat_imap('A', pairs.begin(), pairs.end());
+    if (flat_imap.size() != 2)  compare_not_passed(flat_imap.size(), 2);
 }
 
+void test_range_constructor_unsorted()
+{
+    std::vector<std::pair<int, char>> pairs = { {3, 'B'}, {6, 'B'}, {5, 'C'} };
+    try {
+        interval_map<int, char> imap('A', pairs.begin(), pairs.end());
+        compare_not_passed("interval_map", "std::invalid_argument");
+    }
+    catch (const std::invalid_argument&) {}
+
+    // Initializer lists are sorted by the container, keeping the first of equivalent keys
+    interval_map<int, char> init_imap('A', { {6, 'C'}, {3, 'B'}, {6, 'D'}, {9, 'A'} });
+    interval_map<int, char> ref_imap('A');
+    ref_imap.insert_range(3, 6, 'B');
+    ref_imap.insert_range(6, 9, 'C');
+    assert_ref(init_imap, ref_imap);
+
+    flat_interval_map<int, char> flat_init_imap('A', { {6, 'C'}, {3, 'B'}, {6, 'D'}, {9, 'A'} });
+    if (flat_init_imap.at(7) != 'C')  compare_not_passed(flat_init_imap.at(7), 'C');
+    if (flat_init_imap.size() != 3)  compare_not_passed(flat_init_imap.size(), 3);
+}
+
+void test_veb_set_matches_set()
+{
+    std::mt19937_64 gen(3);
+    veb_set<64> veb;
+    std::set<std::uint64_t> ref;
+
+    for (int i = 0; i < 20000; i++) {
+        // Keys from a few small regions, so that clusters fill up and empty again
+        const std::uint64_t key = (gen() % 4) * 0x4000000000000000 + gen() % 2000;
+        if (ref.count(key) != 0) {
+            veb.erase(key);
+            ref.erase(key);
+        }
+        else {
+            veb.insert(key);
+            ref.insert(key);
+        }
+
+        const std::uint64_t probe = (gen() % 4) * 0x4000000000000000 + gen() % 2000;
+        const auto it = ref.upper_bound(probe);
+        std::uint64_t next;
+        const bool found = veb.successor(probe, next);
+        if (found != (it != ref.end()))  compare_not_passed(probe, found);
+        if (found && next != *it)  compare_not_passed(next, *it);
+    }
+}
+
+void test_veb_matches_map()
+{
+    std::srand(9);
+    interval_map<std::uint32_t, int> ref_imap(0);
+    veb_interval_map<std::uint32_t, int> imap(0);
+
+    for (int i = 0; i < 2000; i++) {
+        const std::uint32_t key_begin = static_cast<std::uint32_t>(rand()) % 5000;
+        const std::uint32_t key_end = key_begin + static_cast<std::uint32_t>(rand()) % 100;
+        const int val = rand() % 4;
+        ref_imap.insert_range(key_begin, key_end, val);
+        imap.insert_range(key_begin, key_end, val);
+    }
+    imap.insert_range(4294967000u, 4294967295u, 7);
+    ref_imap.insert_range(4294967000u, 4294967295u, 7);
+
+    if (!std::equal(imap.begin(), imap.end(), ref_imap.begin(), ref_imap.end()))  compare_not_passed("pairs", "interval_map");
+    for (std::uint32_t key = 0; key < 5200; key++) {
+        if (imap.at(key) != ref_imap.at(key))  compare_not_passed(imap.at(key), ref_imap.at(key));
+    }
+    if (imap.at(4294967295u) != 0)  compare_not_passed(imap.at(4294967295u), 0);
+
+    veb_interval_map<std::uint32_t, int> copy = imap;
+    if (copy.at(4294967294u) != 7)  compare_not_passed(copy.at(4294967294u), 7);
+}
+
+template<class Map>
+void check_cursor_matches_map()
+{
+    std::srand(13);
+    Map ref_imap(0);
+    Map imap(0);
+    typename Map::cursor cursor(imap);
+
+    int key = 500;
+    for (int i = 0; i < 5000; i++) {
+        // Mostly small moves in both directions, sometimes a jump
+        key = (rand() % 20 == 0 ? rand() % 1000 : std::max(0, key + rand() % 41 - 20));
+        if (rand() % 3 == 0) {
+            const int key_end = key + rand() % 10;
+            const int val = rand() % 4;
+            ref_imap.insert_range(key, key_end, val);
+            cursor.insert_range(key, key_end, val);
+        }
+        else if (cursor.at(key) != ref_imap.at(key)) {
+            compare_not_passed(cursor.at(key), ref_imap.at(key));
+        }
+    }
+
+    assert_ref(imap, ref_imap);
+}
+
+void test_cursor_matches_map()
+{
+    check_cursor_matches_map<interval_map<int, int>>();
+    check_cursor_matches_map<flat_interval_map<int, int>>();
+}
+
+template<class Key, class T>
+std::vector<std::pair<Key, T>> collect_pairs(const persistent_interval_map<Key, T>& pmap)
+{
+    std::vector<std::pair<Key, T>> pairs;
+    pmap.for_each([&pairs](const Key& key, const T& val) { pairs.emplace_back(key, val); });
+    return pairs;
+}
+
+void test_persistent_versions()
+{
+    const persistent_interval_map<int, char> v0('A');
+    const auto v1 = v0.insert_range(3, 12, 'B');
+    const auto v2 = v1.insert_range(6, 9, 'C');
+    const auto v3 = v2.insert_range(3, 12, 'A');
+
+    if (!v0.empty())  compare_not_passed(v0.size(), 0);
+    std::vector<std::pair<int, char>> ref1 = { {3, 'B'}, {12, 'A'} };
+    if (collect_pairs(v1) != ref1)  compare_not_passed("pairs", "v1");
+    std::vector<std::pair<int, char>> ref2 = { {3, 'B'}, {6, 'C'}, {9, 'B'}, {12, 'A'} };
+    if (collect_pairs(v2) != ref2)  compare_not_passed("pairs", "v2");
+    if (!v3.empty())  compare_not_passed(v3.size(), 0);
+
+    const auto v4 = v2.set_first_val('B');
+    std::vector<std::pair<int, char>> ref4 = { {6, 'C'}, {9, 'B'}, {12, 'A'} };
+    if (collect_pairs(v4) != ref4)  compare_not_passed("pairs", "v4");
+}
+
+void test_persistent_matches_map()
+{
+    std::srand(17);
+    interval_map<int, int> ref_imap(0);
+    persistent_interval_map<int, int> pmap(0);
+    std::vector<std::pair<persistent_interval_map<int, int>, interval_map<int, int>>> versions;
+
+    for (int i = 0; i < 1000; i++) {
+        const int key_begin = rand() % 1000;
+        const int key_end = key_begin + rand() % 50;
+        const int val = rand() % 4;
+        ref_imap.insert_range(key_begin, key_end, val);
+        pmap = pmap.insert_range(key_begin, key_end, val);
+        if (i % 100 == 0)  versions.emplace_back(pmap, ref_imap);
+    }
+    versions.emplace_back(pmap, ref_imap);
+
+    // Old versions are unaffected by the later modifications
+    for (const auto& version : versions) {
+        std::vector<std::pair<int, int>> ref(version.second.begin(), version.second.end());
+        if (collect_pairs(version.first) != ref)  compare_not_passed("pairs", "interval_map");
+        for (int key = -1; key <= 1050; key++) {
+            if (version.first.at(key) != version.second.at(key))  compare_not_passed(version.first.at(key), version.second.at(key));
+        }
+    }
+}
+
+void test_diff()
+{
+    interval_map<int, char> old_imap('A', { {3, 'B'}, {6, 'C'}, {9, 'B'}, {12, 'A'} });
+    interval_map<int, char> new_imap('A', { {3, 'B'}, {7, 'C'}, {8, 'D'}, {12, 'A'}, {20, 'E'} });
+
+    const interval_map_diff<int, char> changes = diff(old_imap, new_imap);
+    std::vector<std::tuple<int, int, char>> ref_ranges = { {6, 7, 'B'}, {8, 12, 'D'} };
+    if (changes.ranges != ref_ranges)  compare_not_passed("ranges", "ref_ranges");
+    if (!changes.last || *changes.last != std::make_pair(20, 'E'))  compare_not_passed("last", "(20, E)");
+    if (changes.first_val || changes.reset_first_val)  compare_not_passed("first_val", "unchanged");
+
+    apply_diff(old_imap, changes);
+    assert_ref(old_imap, new_imap);
+
+    if (!diff(old_imap, new_imap).empty())  compare_not_passed("diff", "empty");
+
+    // A new first value changes the keys before the first pairs of both maps
+    new_imap.set_first_val('B');
+    const interval_map_diff<int, char> first_changes = diff(old_imap, new_imap);
+    if (first_changes.first_val != 'B')  compare_not_passed("first_val", 'B');
+    apply_diff(old_imap, first_changes);
+    assert_ref(old_imap, new_imap);
+
+    // Keys cannot be unmapped
+    interval_map<int, char> unset_imap;
+    unset_imap.insert(5, 'A');
+    try {
+        diff(old_imap, unset_imap);
+        compare_not_passed("diff", "invalid_argument");
+    }
+    catch (const std::invalid_argument&) {}
+}
+
+void test_diff_matches_maps()
+{
+    std::srand(20);
+    for (int i = 0; i < 200; i++) {
+        interval_map<int, int> old_imap(rand() % 3);
+        for (int j = 0; j < 50; j++)  old_imap.insert_range(rand() % 1000, rand() % 1000, rand() % 3);
+        if (rand() % 2)  old_imap.insert(rand() % 1000, rand() % 3);
+
+        interval_map<int, int> new_imap = old_imap;
+        const int n_changes = rand() % 10;
+        for (int j = 0; j < n_changes; j++)  new_imap.insert_range(rand() % 1000, rand() % 1000, rand() % 3);
+        if (rand() % 4 == 0)  new_imap.set_first_val(rand() % 3);
+        if (rand() % 4 == 0)  new_imap.insert(rand() % 1000, rand() % 3);
+
+        const interval_map_diff<int, int> changes = diff(old_imap, new_imap);
+
+        // The intervals start at keys whose value changes, once the first value is set
+        interval_map<int, int> first_val_imap = old_imap;
+        if (changes.first_val)  first_val_imap.set_first_val(*changes.first_val);
+        for (const auto& range : changes.ranges) {
+            if (new_imap.at(std::get<0>(range)) == first_val_imap.at(std::get<0>(range)))  compare_not_passed("first key", "changed");
+        }
+
+        apply_diff(old_imap, changes);
+        assert_ref(old_imap, new_imap);
+    }
+}
+
+void test_journal_effective_changes()
+{
+    journaled_interval_map<int, char> jmap('A');
+    jmap.insert_range(0, 10, 'B');
+    jmap.insert_range(5, 15, 'B');
+    jmap.insert_range(2, 4, 'B');
+    jmap.insert(20, 'C');
+    jmap.set_first_val('B');
+
+    using entry = interval_map_journal_entry<int, char>;
+    std::vector<entry> ref = {
+        { 0, 10, 'B' },
+        { 10, 15, 'B' },
+        { 20, std::nullopt, 'C' },
+        { std::nullopt, 0, 'B' }
+    };
+    if (jmap.journal() != ref)  compare_not_passed("journal", "ref");
+
+    // Compaction folds the overlapping entries, by decreasing key
+    std::vector<entry> ref_compacted = {
+        { 20, std::nullopt, 'C' },
+        { std::nullopt, 15, 'B' }
+    };
+    const std::vector<entry> entries = jmap.flush();
+    if (entries != ref_compacted)  compare_not_passed("flush", "ref_compacted");
+    if (!jmap.journal().empty())  compare_not_passed(jmap.journal().size(), 0);
+}
+
+template<class JournaledMap>
+void check_journal_replay(JournaledMap& jmap, typename JournaledMap::map_type replica, bool first_val)
+{
+    for (int i = 0; i < 2000; i++) {
+        const int key_begin = rand() % 1000;
+        try {
+            switch (rand() % 8) {
+            case 0:
+                jmap.insert(key_begin, rand() % 4);
+                break;
+            case 1:
+                if (first_val)  jmap.set_first_val(rand() % 4);
+                break;
+            default:
+                jmap.insert_range(key_begin, key_begin + rand() % 100, rand() % 4);
+                break;
+            }
+        }
+        catch (const std::out_of_range&) {}
+
+        if (rand() % 50 == 0) {
+            // Replay one batch as recorded, and the next ones compacted through the encoding
+            if (i < 100) {
+                replay_journal(replica, jmap.journal());
+                jmap.flush();
+            }
+            else {
+                std::stringstream stream;
+                encode_journal(jmap.flush(), stream);
+                replay_journal(replica, decode_journal<int, int>(stream));
+            }
+            assert_ref(replica, jmap.map());
+        }
+    }
+}
+
+void test_journal_replay()
+{
+    std::srand(21);
+    for (int i = 0; i < 20; i++) {
+        journaled_interval_map<int, int> jmap(0);
+        check_journal_replay(jmap, jmap.map(), true);
+
+        journaled_interval_map<int, int> unset_jmap;
+        unset_jmap.insert(500, 1);
+        check_journal_replay(unset_jmap, unset_jmap.map(), false);
+    }
+}
+
+void test_journal_encoding()
+{
+    using entry = interval_map_journal_entry<std::int64_t, double>;
+    std::vector<entry> entries = {
+        { std::nullopt, -5, 1.5 },
+        { 1000000, 1000010, 2.5 },
+        { -3, std::nullopt, 3.5 },
+        { std::nullopt, std::nullopt, 4.5 }
+    };
+
+    std::stringstream stream;
+    encode_journal(entries, stream);
+    const std::vector<entry> decoded = decode_journal<std::int64_t, double>(stream);
+    if (decoded != entries)  compare_not_passed("decoded", "entries");
+
+    std::stringstream truncated(stream.str().substr(0, stream.str().size() - 1));
+    try {
+        decode_journal<std::int64_t, double>(truncated);
+        compare_not_passed("decode_journal", "runtime_error");
+    }
+    catch (const std::runtime_error&) {}
+}
+
+void test_buffered_matches_map()
+{
+    std::srand(22);
+    for (std::size_t threshold : { 1, 16, 256 }) {
+        interval_map<int, int> ref_imap(0);
+        buffered_interval_map<int, int> bmap(0, threshold);
+
+        for (int i = 0; i < 5000; i++) {
+            const int key_begin = rand() % 1000;
+            const int val = rand() % 4;
+
+            switch (rand() % 40) {
+            case 0:
+                ref_imap.insert(key_begin, val);
+                bmap.insert(key_begin, val);
+                break;
+            case 1:
+                ref_imap.set_first_val(val);
+                bmap.set_first_val(val);
+                break;
+            case 2:
+                bmap.flush();
+                if (bmap.buffered() != 0)  compare_not_passed(bmap.buffered(), 0);
+                break;
+            default: {
+                const int key_end = key_begin + rand() % 100;
+                ref_imap.insert_range(key_begin, key_end, val);
+                bmap.insert_range(key_begin, key_end, val);
+                break;
+            }
+            }
+
+            // Lookups see the buffered assignments
+            const int key = rand() % 1100;
+            if (bmap.at(key) != ref_imap.at(key))  compare_not_passed(bmap.at(key), ref_imap.at(key));
+            if (bmap.buffered() >= threshold)  compare_not_passed(bmap.buffered(), threshold);
+        }
+
+        assert_ref(bmap.map(), ref_imap);
+    }
+}
+
+template<class IntervalMap>
+void check_at_many_unsorted(std::size_t n, bool first_val)
+{
+    IntervalMap imap;
+    if (first_val)  imap.set_first_val(-1);
+    for (std::size_t i = 0; i < n; i++)  imap.insert(rand() % 10000, rand() % 4);
+    const frozen_interval_map frozen(imap);
+
+    std::vector<int> keys;
+    for (int i = 0; i < 1000; i++)  keys.push_back(rand() % 11000 - 500);
+    if (!first_val) {
+        keys.erase(std::remove_if(keys.begin(), keys.end(), [&imap](int key) {
+            return imap.size() == 0 || key < imap.begin()->first;
+        }), keys.end());
+    }
+
+    std::vector<int> ref_vals;
+    for (int key : keys)  ref_vals.push_back(imap.at(key));
+
+    std::vector<int> vals;
+    imap.at_many_unsorted(keys.begin(), keys.end(), std::back_inserter(vals));
+    if (vals != ref_vals)  compare_not_passed("at_many_unsorted", "at");
+
+    vals.clear();
+    frozen.at_many(keys.begin(), keys.end(), std::back_inserter(vals));
+    if (vals != ref_vals)  compare_not_passed("frozen at_many", "at");
+
+    if (!first_val) {
+        const std::vector<int> unmapped = { 20000, -1000 };
+        bool thrown = false;
+        try {
+            imap.at_many_unsorted(unmapped.begin(), unmapped.end(), std::back_inserter(vals));
+        }
+        catch (const std::out_of_range&) {
+            thrown = true;
+        }
+        if (!thrown)  compare_not_passed("at_many_unsorted", "out_of_range");
+
+        thrown = false;
+        try {
+            frozen.at_many(unmapped.begin(), unmapped.end(), std::back_inserter(vals));
+        }
+        catch (const std::out_of_range&) {
+            thrown = true;
+        }
+        if (!thrown)  compare_not_passed("frozen at_many", "out_of_range");
+    }
+}
+
+void test_at_many_unsorted()
+{
+    std::srand(24);
+    for (std::size_t n : { 0, 1, 2, 31, 32, 33, 700, 5000 }) {
+        for (bool first_val : { true, false }) {
+            check_at_many_unsorted<interval_map<int, int>>(n, first_val);
+            check_at_many_unsorted<flat_interval_map<int, int>>(n, first_val);
+        }
+    }
+}
+
+template<class Key>
+void check_simd_matches_map(std::size_t n, bool first_val)
+{
+    interval_map<Key, int> imap;
+    if (first_val)  imap.set_first_val(-1);
+    for (std::size_t i = 0; i < n; i++)  imap.insert(static_cast<Key>(rand() % 100000 - 50000), rand() % 4);
+
+    std::vector<Key> keys = { std::numeric_limits<Key>::lowest(), std::numeric_limits<Key>::max(), Key(0) };
+    if constexpr (std::is_floating_point_v<Key>) {
+        keys.push_back(std::numeric_limits<Key>::infinity());
+        keys.push_back(-std::numeric_limits<Key>::infinity());
+        keys.push_back(std::numeric_limits<Key>::quiet_NaN());
+        keys.push_back(Key(-0.0));
+        for (int i = 0; i < 1000; i++)  keys.push_back(static_cast<Key>(rand() % 110000 - 55000) / 2);
+    }
+    for (const auto& pair : imap)  keys.push_back(pair.first);
+    for (int i = 0; i < 1000; i++)  keys.push_back(static_cast<Key>(rand() % 110000 - 55000));
+
+    for (simd_level level : { simd_level::scalar, simd_level::avx2, simd_level::avx512 }) {
+        const simd_interval_map<Key, int> simd_imap(imap, level);
+
+        for (const Key& key : keys) {
+            std::optional<int> val, ref_val;
+            try {
+                val = simd_imap.at(key);
+            }
+            catch (const std::out_of_range&) {}
+            try {
+                ref_val = imap.at(key);
+            }
+            catch (const std::out_of_range&) {}
+
+            if (val != ref_val)  compare_not_passed(key, val.value_or(-2));
+        }
+    }
+
+    if (first_val) {
+        const simd_interval_map<Key, int> simd_imap(imap);
+        std::vector<int> vals;
+        simd_imap.at_many(keys.begin(), keys.end(), std::back_inserter(vals));
+        std::vector<int> ref_vals;
+        imap.at_many(keys.begin(), keys.end(), std::back_inserter(ref_vals));
+        if (vals != ref_vals)  compare_not_passed("at_many", "interval_map::at_many");
+    }
+}
+
+void test_simd_matches_map()
+{
+    std::srand(23);
+    for (std::size_t n : { 0, 1, 15, 16, 17, 300, 5000 }) {
+        for (bool first_val : { true, false }) {
+            if (n == 0 && !first_val)  continue;
+            check_simd_matches_map<std::int32_t>(n, first_val);
+            check_simd_matches_map<std::int64_t>(n, first_val);
+            check_simd_matches_map<float>(n, first_val);
+        }
+    }
+}
+
+template<class Key>
+void check_succinct_matches_map(std::size_t n, Key spread, bool first_val, bool extremes)
+{
+    interval_map<Key, int> imap;
+    if (first_val)  imap.set_first_val(-1);
+    Key base = static_cast<Key>(rand() % 1000 - 500);
+    for (std::size_t i = 0; i < n; i++)  imap.insert(static_cast<Key>(base + static_cast<Key>(rand()) % spread), rand() % 4);
+    if (extremes) {
+        imap.insert(std::numeric_limits<Key>::lowest(), 5);
+        imap.insert(std::numeric_limits<Key>::max(), 6);
+    }
+    const succinct_interval_map<Key, int> succinct(imap);
+
+    std::vector<Key> keys = { std::numeric_limits<Key>::lowest(), std::numeric_limits<Key>::max(), Key(0) };
+    for (const auto& pair : imap) {
+        keys.push_back(pair.first);
+        if (pair.first != std::numeric_limits<Key>::lowest())  keys.push_back(static_cast<Key>(pair.first - 1));
+        if (pair.first != std::numeric_limits<Key>::max())  keys.push_back(static_cast<Key>(pair.first + 1));
+    }
+    for (int i = 0; i < 1000; i++)  keys.push_back(static_cast<Key>(base - 10 + static_cast<Key>(rand()) % (spread + 20)));
+
+    for (const Key& key : keys) {
+        std::optional<int> val, ref_val;
+        try {
+            val = succinct.at(key);
+        }
+        catch (const std::out_of_range&) {}
+        try {
+            ref_val = imap.at(key);
+        }
+        catch (const std::out_of_range&) {}
+
+        if (val != ref_val)  compare_not_passed(key, val.value_or(-2));
+    }
+}
+
+void test_succinct_matches_map()
+{
+    std::srand(25);
+    for (std::size_t n : { 0, 1, 2, 100, 3000 }) {
+        for (bool first_val : { true, false }) {
+            for (bool extremes : { false, true }) {
+                // Dense keys store no low bits, sparse keys most of them
+                check_succinct_matches_map<int>(n, 50, first_val, extremes);
+                check_succinct_matches_map<int>(n, 100000, first_val, extremes);
+                check_succinct_matches_map<std::int64_t>(n, 1000000000, first_val, extremes);
+                check_succinct_matches_map<unsigned>(n, 5000, first_val, extremes);
+            }
+        }
+    }
+}
 
 int main()
 {
@@ -361,19 +1777,65 @@ int main()
         test_insert_range_first_val_overwrite_all,
         test_insert_range_extend_previous,
         test_insert_range_extend_next,
-        test_swap
+        test_swap,
+        test_at,
+        test_at_without_first_val,
+        test_flat_insert_range,
+        test_flat_insert_overwrite_same_as_prev,
+        test_flat_matches_map,
+        test_flat_emplace_exception_safety,
+        test_insert_ranges,
+        test_insert_ranges_matches_insert_range,
+        test_insert_ranges_without_first_val,
+        test_insert_ranges_without_first_val_matches_insert_range,
+        test_parallel_insert_ranges,
+        test_diff,
+        test_diff_matches_maps,
+        test_journal_effective_changes,
+        test_journal_replay,
+        test_journal_encoding,
+        test_buffered_matches_map,
+        test_at_many_unsorted,
+        test_simd_matches_map,
+        test_succinct_matches_map,
+        test_at_many,
+        test_frozen,
+        test_frozen_without_first_val,
+        test_frozen_keeps_comparator,
+        test_concurrent_readers,
+        test_concurrent_reader_slots,
+        test_sharded_insert_range_across_shards,
+        test_sharded_keeps_comparator,
+        test_sharded_parallel_writers,
+        test_pooled_matches_map,
+        test_pool_allocator_reuses_blocks,
+        test_interned,
+        test_interned_compact,
+        test_for_each_segment,
+        test_for_each_segment_without_first_val,
+        test_merge,
+        test_merge_coalesces,
+        test_merge_matches_at,
+        test_merge_without_first_val,
+        test_merge_keeps_allocator,
+        test_aggregate_add_range,
+        test_aggregate_matches_brute_force,
+        test_save_load,
+        test_mapped,
+        test_range_constructor_coalesces,
+        test_range_constructor_unsorted,
+        test_veb_set_matches_set,
+        test_veb_matches_map,
+        test_cursor_matches_map,
+        test_persistent_versions,
+        test_persistent_matches_map
     };
 
     for (auto it = std::cbegin(tests); it != std::cend(tests); it++) {
         (*it)();
     }
 
-    std::cout << "All test passed!\nBenchmarking insert_range function...\n";
-
-    interval_map<int, int> imap(0);
-    std::srand(0);
-    const std::chrono::duration<double> elapsed_seconds = benchmark_imap(imap, 2000, 100, 100, 20);
-    std::cout << "Benchmark completed in " << elapsed_seconds.count() << " seconds.\n";
+    std::cout << "All test passed!\n";
 
     return 0;
 }
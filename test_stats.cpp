@@ -0,0 +1,72 @@
+#define INTERVAL_MAP_STATS
+
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <thread>
+#include <vector>
+
+#include "interval_map.hpp"
+
+#define compare_not_passed( a, b ) { \
+    std::cerr << "Test \"" << __FUNCTION__ << "\" not passed on " << a << " and " << b << "\n"; \
+    exit(1); \
+}
+
+void test_stats()
+{
+    interval_map<int, char, counted_compare<std::less<int>>> imap('A');
+    imap.insert_range(3, 12, 'B');
+    imap.insert_range(6, 9, 'C');
+    imap.insert_range(3, 12, 'A');
+    imap.at(5);
+
+    const interval_map_stats& stats = imap.stats();
+    if (stats.insert_ranges != 3)  compare_not_passed(stats.insert_ranges, 3);
+    if (stats.lookups != 1)  compare_not_passed(stats.lookups, 1);
+    if (stats.nodes_allocated != 4)  compare_not_passed(stats.nodes_allocated, 4);
+    if (stats.nodes_erased != 4)  compare_not_passed(stats.nodes_erased, 4);
+    if (stats.segments_coalesced != 2)  compare_not_passed(stats.segments_coalesced, 2);
+    if (stats.erase_spans != 3)  compare_not_passed(stats.erase_spans, 3);
+    if (stats.erase_span_max != 3)  compare_not_passed(stats.erase_span_max, 3);
+    if (stats.key_compares == 0)  compare_not_passed(stats.key_compares, "> 0");
+
+    imap.reset_stats();
+    if (imap.stats().lookups != 0)  compare_not_passed(imap.stats().lookups, 0);
+}
+
+void test_stats_concurrent_readers()
+{
+    interval_map<int, char, counted_compare<std::less<int>>> imap('A');
+    for (int i = 0; i < 100; i++)  imap.insert_range(i * 10, i * 10 + 5, static_cast<char>('B' + i % 20));
+    imap.reset_stats();
+
+    const auto& const_imap = imap;
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; t++) {
+        readers.emplace_back([&const_imap, t]() {
+            for (int i = 0; i < 1000; i++)  const_imap.at((i * 7 + t) % 1000);
+        });
+    }
+    for (std::thread& reader : readers)  reader.join();
+
+    if (imap.stats().lookups != 4000)  compare_not_passed(imap.stats().lookups, 4000);
+    if (imap.stats().key_compares == 0)  compare_not_passed(imap.stats().key_compares, "> 0");
+}
+
+int main()
+{
+    void (*tests[])() = {
+        test_stats,
+        test_stats_concurrent_readers
+    };
+
+    for (auto it = std::cbegin(tests); it != std::cend(tests); it++) {
+        (*it)();
+    }
+
+    std::cout << "All test passed!\n";
+
+    return 0;
+}
@@ -0,0 +1,551 @@
+#ifndef _VEB_MAP_HPP
+#define _VEB_MAP_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <limits>
+#include <map>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "interval_map.hpp"
+
+/**
+ * Hash table with unsigned 64-bit keys, used by veb_set for its clusters.
+ *
+ * Open addressing with linear probing, Fibonacci hashing and backward-shift deletion, so a
+ * lookup usually touches a single cache line. The values are stored in the slots, and move
+ * when the table grows.
+ *
+ * @tparam V The type of the values, default constructible
+ */
+template<class V>
+class veb_table
+{
+protected:
+    struct slot
+    {
+        std::uint64_t key{ 0 };
+        V val{};
+        bool used{ false };
+    };
+
+    std::vector<slot> slots_{};
+    std::size_t size_{ 0 };
+
+    /**
+     * 64 minus the base-2 logarithm of the capacity.
+     */
+    unsigned shift_{ 64 };
+
+public:
+    std::size_t size() const noexcept { return size_; }
+
+    V* find(std::uint64_t key) { return const_cast<V*>(static_cast<const veb_table*>(this)->find(key)); }
+
+    const V* find(std::uint64_t key) const
+    {
+        if (size_ == 0)  return nullptr;
+
+        const std::size_t mask = slots_.size() - 1;
+        for (std::size_t i = index(key);; i = (i + 1) & mask) {
+            if (!slots_[i].used)  return nullptr;
+            if (slots_[i].key == key)  return &slots_[i].val;
+        }
+    }
+
+    /**
+     * Inserts a default-constructed value for a key that is not in the table.
+     *
+     * @return a reference to the value
+     */
+    V& insert(std::uint64_t key)
+    {
+        if ((size_ + 1) * 2 > slots_.size())  grow();
+
+        const std::size_t mask = slots_.size() - 1;
+        std::size_t i = index(key);
+        while (slots_[i].used)  i = (i + 1) & mask;
+
+        slots_[i].key = key;
+        slots_[i].used = true;
+        size_++;
+        return slots_[i].val;
+    }
+
+    /**
+     * Erases a key that is in the table.
+     */
+    void erase(std::uint64_t key)
+    {
+        const std::size_t mask = slots_.size() - 1;
+        std::size_t i = index(key);
+        while (slots_[i].key != key || !slots_[i].used)  i = (i + 1) & mask;
+
+        // Move back the following keys of the run that would not be found past the hole
+        for (std::size_t j = (i + 1) & mask; slots_[j].used; j = (j + 1) & mask) {
+            const std::size_t home = index(slots_[j].key);
+            if (((j - home) & mask) >= ((j - i) & mask)) {
+                slots_[i] = std::move(slots_[j]);
+                i = j;
+            }
+        }
+
+        slots_[i] = slot();
+        size_--;
+    }
+
+    void clear()
+    {
+        slots_.clear();
+        size_ = 0;
+        shift_ = 64;
+    }
+
+private:
+    std::size_t index(std::uint64_t key) const noexcept
+    {
+        return static_cast<std::size_t>((key * 0x9e3779b97f4a7c15) >> shift_);
+    }
+
+    void grow()
+    {
+        std::vector<slot> old(slots_.empty() ? 8 : slots_.size() * 2);
+        old.swap(slots_);
+        shift_ = 64;
+        for (std::size_t n = slots_.size(); n > 1; n >>= 1)  shift_--;
+        size_ = 0;
+
+        for (slot& s : old) {
+            if (s.used)  insert(s.key) = std::move(s.val);
+        }
+    }
+};
+
+/**
+ * Set of `Bits`-bit unsigned integers with O(log log U) successor queries, where U = 2^Bits.
+ *
+ * Van Emde Boas tree: the high half of an element selects a cluster, a set over the low half,
+ * and a summary set over the high halves keeps track of the non-empty clusters. The minimum is
+ * stored outside the clusters, so inserting into an empty cluster and erasing the last element
+ * of a cluster take constant time, and every operation recurses into a single half. Clusters
+ * are kept in a hash table, so memory is proportional to the number of elements.
+ *
+ * Sets of at most 8 bits are a 256-bit bitmap.
+ *
+ * @tparam Bits The number of bits of the elements
+ */
+template<unsigned Bits, bool Leaf = (Bits <= 8)>
+class veb_set;
+
+template<unsigned Bits>
+class veb_set<Bits, true>
+{
+    std::uint64_t words_[4]{};
+
+public:
+    bool empty() const noexcept { return (words_[0] | words_[1] | words_[2] | words_[3]) == 0; }
+
+    bool contains(std::uint64_t x) const noexcept { return (words_[x >> 6] >> (x & 63)) & 1; }
+
+    void insert(std::uint64_t x) noexcept { words_[x >> 6] |= std::uint64_t(1) << (x & 63); }
+
+    void erase(std::uint64_t x) noexcept { words_[x >> 6] &= ~(std::uint64_t(1) << (x & 63)); }
+
+    std::uint64_t min() const noexcept
+    {
+        std::size_t i = 0;
+        while (words_[i] == 0)  i++;
+        return i * 64 + ctz(words_[i]);
+    }
+
+    std::uint64_t max() const noexcept
+    {
+        std::size_t i = 3;
+        while (words_[i] == 0)  i--;
+        return i * 64 + 63 - clz(words_[i]);
+    }
+
+    /**
+     * Finds the least element greater than `x`.
+     *
+     * @return true if it exists, in which case it is stored in `out`
+     */
+    bool successor(std::uint64_t x, std::uint64_t& out) const noexcept
+    {
+        if (x >= 255)  return false;
+
+        std::size_t i = (x + 1) >> 6;
+        std::uint64_t word = words_[i] & (~std::uint64_t(0) << ((x + 1) & 63));
+        while (word == 0) {
+            if (++i == 4)  return false;
+            word = words_[i];
+        }
+        out = i * 64 + ctz(word);
+        return true;
+    }
+
+private:
+    static std::uint64_t ctz(std::uint64_t x) noexcept
+    {
+#if defined(__GNUC__)
+        return static_cast<std::uint64_t>(__builtin_ctzll(x));
+#else
+        std::uint64_t n = 0;
+        for (; (x & 1) == 0; x >>= 1)  n++;
+        return n;
+#endif
+    }
+
+    static std::uint64_t clz(std::uint64_t x) noexcept
+    {
+#if defined(__GNUC__)
+        return static_cast<std::uint64_t>(__builtin_clzll(x));
+#else
+        std::uint64_t n = 0;
+        for (; (x >> 63) == 0; x <<= 1)  n++;
+        return n;
+#endif
+    }
+};
+
+template<unsigned Bits>
+class veb_set<Bits, false>
+{
+    static constexpr unsigned low_bits = Bits / 2;
+    static constexpr unsigned high_bits = Bits - low_bits;
+    static constexpr std::uint64_t low_mask = (std::uint64_t(1) << low_bits) - 1;
+
+    std::uint64_t min_{ 0 };
+    std::uint64_t max_{ 0 };
+    bool empty_{ true };
+
+    /**
+     * High halves of the elements other than the minimum.
+     */
+    veb_set<high_bits> summary_{};
+
+    /**
+     * Low halves of the elements other than the minimum, by high half.
+     */
+    veb_table<veb_set<low_bits>> clusters_{};
+
+public:
+    bool empty() const noexcept { return empty_; }
+    std::uint64_t min() const noexcept { return min_; }
+    std::uint64_t max() const noexcept { return max_; }
+
+    /**
+     * Inserts an element that is not in the set.
+     */
+    void insert(std::uint64_t x)
+    {
+        if (empty_) {
+            min_ = max_ = x;
+            empty_ = false;
+            return;
+        }
+
+        if (x < min_)  std::swap(x, min_);
+        if (x > max_)  max_ = x;
+
+        const std::uint64_t high = x >> low_bits;
+        veb_set<low_bits>* cluster = clusters_.find(high);
+        if (cluster == nullptr) {
+            summary_.insert(high);
+            cluster = &clusters_.insert(high);
+        }
+        cluster->insert(x & low_mask);
+    }
+
+    /**
+     * Erases an element that is in the set.
+     */
+    void erase(std::uint64_t x)
+    {
+        if (min_ == max_) {
+            empty_ = true;
+            return;
+        }
+
+        // The next element becomes the minimum, and leaves its cluster
+        if (x == min_) {
+            const std::uint64_t high = summary_.min();
+            x = (high << low_bits) | clusters_.find(high)->min();
+            min_ = x;
+        }
+
+        const std::uint64_t high = x >> low_bits;
+        veb_set<low_bits>* cluster = clusters_.find(high);
+        cluster->erase(x & low_mask);
+        if (cluster->empty()) {
+            clusters_.erase(high);
+            summary_.erase(high);
+        }
+
+        if (x == max_) {
+            if (summary_.empty()) {
+                max_ = min_;
+            }
+            else {
+                const std::uint64_t max_high = summary_.max();
+                max_ = (max_high << low_bits) | clusters_.find(max_high)->max();
+            }
+        }
+    }
+
+    /**
+     * Finds the least element greater than `x`.
+     *
+     * @return true if it exists, in which case it is stored in `out`
+     */
+    bool successor(std::uint64_t x, std::uint64_t& out) const
+    {
+        if (empty_ || x >= max_)  return false;
+        if (x < min_) {
+            out = min_;
+            return true;
+        }
+
+        const std::uint64_t high = x >> low_bits;
+        const veb_set<low_bits>* cluster = clusters_.find(high);
+        std::uint64_t low = 0;
+        if (cluster != nullptr && (x & low_mask) < cluster->max()) {
+            cluster->successor(x & low_mask, low);
+            out = (high << low_bits) | low;
+            return true;
+        }
+
+        // x < max_, so a later cluster exists
+        std::uint64_t next_high = 0;
+        summary_.successor(high, next_high);
+        out = (next_high << low_bits) | clusters_.find(next_high)->min();
+        return true;
+    }
+};
+
+/**
+ * Sorted associative container of unsigned integer keys, with O(log log U) `upper_bound` and
+ * `lower_bound`, where U is the number of possible keys.
+ *
+ * The pairs are stored in a std::map, which provides the iterators and the iteration order,
+ * and the keys are indexed by a veb_set, whose successor queries replace the searches of the
+ * tree, and by a hash table from keys to iterators. This costs about twice the memory of a
+ * std::map, and makes insertions and erasures slower.
+ *
+ * @tparam Key The type of the key, an unsigned integer
+ * @tparam T The type of the values
+ * @tparam Allocator Allocator of each element in the container
+ */
+template<class Key, class T, class Allocator = std::allocator<std::pair<const Key, T>>>
+class veb_map
+{
+    static_assert(std::is_integral_v<Key> && std::is_unsigned_v<Key>, "veb_map requires unsigned integer keys");
+
+public:
+    using map_type = std::map<Key, T, std::less<Key>, Allocator>;
+    using key_type = Key;
+    using mapped_type = T;
+    using value_type = typename map_type::value_type;
+    using key_compare = std::less<Key>;
+    using allocator_type = Allocator;
+    using pointer = typename map_type::pointer;
+    using const_pointer = typename map_type::const_pointer;
+    using reference = typename map_type::reference;
+    using const_reference = typename map_type::const_reference;
+    using size_type = typename map_type::size_type;
+    using difference_type = typename map_type::difference_type;
+    using iterator = typename map_type::iterator;
+    using const_iterator = typename map_type::const_iterator;
+    using reverse_iterator = typename map_type::reverse_iterator;
+    using const_reverse_iterator = typename map_type::const_reverse_iterator;
+
+protected:
+    map_type map_;
+    veb_set<std::numeric_limits<Key>::digits> keys_{};
+    veb_table<iterator> positions_{};
+
+public:
+    veb_map() {}
+
+    explicit veb_map(const key_compare&, const Allocator& alloc = Allocator()) : map_(alloc) {}
+
+    veb_map(std::initializer_list<value_type> init)
+    {
+        for (const value_type& value : init)  insert(value);
+    }
+
+    veb_map(const veb_map& other) : map_(other.map_) { index(); }
+
+    veb_map(veb_map&&) = default;
+
+    veb_map& operator=(const veb_map& other)
+    {
+        if (this != &other) {
+            veb_map copy(other);
+            swap(copy);
+        }
+        return *this;
+    }
+
+    veb_map& operator=(veb_map&&) = default;
+
+    iterator begin() noexcept { return map_.begin(); }
+    const_iterator begin() const noexcept { return map_.begin(); }
+    iterator end() noexcept { return map_.end(); }
+    const_iterator end() const noexcept { return map_.end(); }
+    reverse_iterator rbegin() noexcept { return map_.rbegin(); }
+    const_reverse_iterator rbegin() const noexcept { return map_.rbegin(); }
+    reverse_iterator rend() noexcept { return map_.rend(); }
+    const_reverse_iterator rend() const noexcept { return map_.rend(); }
+    const_iterator cbegin() const noexcept { return map_.cbegin(); }
+    const_iterator cend() const noexcept { return map_.cend(); }
+    const_reverse_iterator crbegin() const noexcept { return map_.crbegin(); }
+    const_reverse_iterator crend() const noexcept { return map_.crend(); }
+
+    [[nodiscard]] bool empty() const noexcept { return map_.empty(); }
+    size_type size() const noexcept { return map_.size(); }
+    size_type max_size() const noexcept { return map_.max_size(); }
+    allocator_type get_allocator() const { return map_.get_allocator(); }
+    key_compare key_comp() const { return key_compare(); }
+
+    iterator find(const key_type& key)
+    {
+        iterator* pos = positions_.find(key);
+        return (pos == nullptr ? map_.end() : *pos);
+    }
+
+    const_iterator find(const key_type& key) const
+    {
+        const iterator* pos = positions_.find(key);
+        return (pos == nullptr ? map_.end() : const_iterator(*pos));
+    }
+
+    size_type count(const key_type& key) const { return (positions_.find(key) == nullptr ? 0 : 1); }
+
+    iterator upper_bound(const key_type& key)
+    {
+        std::uint64_t next;
+        return (keys_.successor(key, next) ? *positions_.find(next) : map_.end());
+    }
+
+    const_iterator upper_bound(const key_type& key) const
+    {
+        std::uint64_t next;
+        return (keys_.successor(key, next) ? const_iterator(*positions_.find(next)) : map_.cend());
+    }
+
+    iterator lower_bound(const key_type& key)
+    {
+        iterator* pos = positions_.find(key);
+        return (pos == nullptr ? upper_bound(key) : *pos);
+    }
+
+    const_iterator lower_bound(const key_type& key) const
+    {
+        const iterator* pos = positions_.find(key);
+        return (pos == nullptr ? upper_bound(key) : const_iterator(*pos));
+    }
+
+    template<class K, class M>
+    iterator emplace_hint(const_iterator hint, K&& key, M&& obj)
+    {
+        const size_type n = map_.size();
+        iterator it = map_.emplace_hint(hint, std::forward<K>(key), std::forward<M>(obj));
+
+        if (map_.size() != n) {
+            try {
+                positions_.insert(it->first) = it;
+                keys_.insert(it->first);
+            }
+            catch (...) {
+                if (positions_.find(it->first) != nullptr)  positions_.erase(it->first);
+                map_.erase(it);
+                throw;
+            }
+        }
+        return it;
+    }
+
+    template<class K, class M>
+    std::pair<iterator, bool> emplace(K&& key, M&& obj)
+    {
+        const size_type n = map_.size();
+        iterator it = emplace_hint(lower_bound(key), std::forward<K>(key), std::forward<M>(obj));
+        return { it, map_.size() != n };
+    }
+
+    std::pair<iterator, bool> insert(const value_type& value) { return emplace(value.first, value.second); }
+
+    iterator erase(const_iterator pos)
+    {
+        keys_.erase(pos->first);
+        positions_.erase(pos->first);
+        return map_.erase(pos);
+    }
+
+    iterator erase(const_iterator first, const_iterator last)
+    {
+        while (first != last)  first = erase(first);
+        return map_.erase(last, last);
+    }
+
+    size_type erase(const key_type& key)
+    {
+        const iterator* pos = positions_.find(key);
+        if (pos == nullptr)  return 0;
+        erase(*pos);
+        return 1;
+    }
+
+    void clear()
+    {
+        map_.clear();
+        keys_ = veb_set<std::numeric_limits<Key>::digits>();
+        positions_.clear();
+    }
+
+    void swap(veb_map& other)
+    {
+        map_.swap(other.map_);
+        std::swap(keys_, other.keys_);
+        std::swap(positions_, other.positions_);
+    }
+
+    bool operator==(const veb_map& rhs) const { return map_ == rhs.map_; }
+    bool operator!=(const veb_map& rhs) const { return map_ != rhs.map_; }
+    bool operator<(const veb_map& rhs) const { return map_ < rhs.map_; }
+    bool operator<=(const veb_map& rhs) const { return map_ <= rhs.map_; }
+    bool operator>(const veb_map& rhs) const { return map_ > rhs.map_; }
+    bool operator>=(const veb_map& rhs) const { return map_ >= rhs.map_; }
+
+private:
+    /**
+     * Indexes all the keys of the map.
+     */
+    void index()
+    {
+        for (iterator it = map_.begin(); it != map_.end(); ++it) {
+            positions_.insert(it->first) = it;
+            keys_.insert(it->first);
+        }
+    }
+};
+
+/**
+ * Interval map of unsigned integer keys, storing its intervals in a veb_map.
+ */
+template<class Key, class T>
+using veb_interval_map = interval_map<
+    Key,
+    T,
+    std::less<Key>,
+    std::allocator<std::pair<const Key, T>>,
+    veb_map<Key, T>
+>;
+
+#endif